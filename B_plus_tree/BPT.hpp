@@ -4,18 +4,24 @@
 
 #include "../file/Myfile.hpp"
 #include "../file/Datafile.hpp"
+#include "../file/Bloomfilter.hpp"
+#include "../file/Keycode.hpp"
 #include "../STLite/algorithm.hpp"
 
 namespace sjtu
 {
 
-template<typename K, typename V, class Comp = std::less<K>>
+// keys are stored in nodes as Key_Code<K>::code
+template<typename K, typename V, template<typename> class Filter = No_Filter,
+         class Comp = std::less<typename Key_Code<K>::code>>
 class BPT
 {
 public:
-    BPT(const std::string& name): file(name + "_index", head), data(name + "_data")
+    BPT(const std::string& name): file(name + "_index", head), data(name + "_data"), filter(name + "_filter")
     {
         head = file.head();
+        if (filter.need_rebuild())
+            rebuild_filter();
     }
     ~BPT()
     {
@@ -24,30 +30,62 @@ public:
 
     const V* readonly(const K& key)
     {
-        if (!head) return nullptr;
+        const Code& code = Key_Code<K>::encode(key);
+        if (!head || !filter.may_contain(code)) return nullptr;
         const Node* tmp;
-        long tofind = find_Node(key);
+        long tofind = find_Node(code);
         tmp = file.readonly(tofind);
-        const K* found = lower_bound(tmp->key, tmp->key+tmp->size, key, comp);
+        const Code* found = lower_bound(tmp->key, tmp->key+tmp->size, code, comp);
         int locat = found - tmp->key;
-        if (locat == tmp->size || !(*found == key)) return nullptr;
+        if (locat == tmp->size || !(*found == code)) return nullptr;
         return data.readonly(tmp->ptr[locat]);
     }
 
     V* readwrite(const K& key)
     {
-        if (!head) return nullptr;
+        const Code& code = Key_Code<K>::encode(key);
+        if (!head || !filter.may_contain(code)) return nullptr;
         const Node* tmp;
-        long tofind = find_Node(key);
+        long tofind = find_Node(code);
         tmp = file.readonly(tofind);
-        const K* found = lower_bound(tmp->key, tmp->key+tmp->size, key, comp);
+        const Code* found = lower_bound(tmp->key, tmp->key+tmp->size, code, comp);
         int locat = found - tmp->key;
-        if (locat == tmp->size || !(*found == key)) return nullptr;
+        if (locat == tmp->size || !(*found == code)) return nullptr;
         return data.readwrite(tmp->ptr[locat]);
     }
 
+    // load the leaves and then the values of keys with batched reads
+    void prefetch(const K* keys, int n)
+    {
+        if (!head) return;
+        Code codes[MAX_BATCH];
+        long address[MAX_BATCH];
+        int size = 0;
+        for (int i = 0; i < n && size < MAX_BATCH; i++)
+        {
+            codes[size] = Key_Code<K>::encode(keys[i]);
+            if (filter.may_contain(codes[size]))
+            {
+                address[size] = find_Node(codes[size]);
+                size++;
+            }
+        }
+        file.prefetch(address, size);
+        int num = 0;
+        for (int i = 0; i < size; i++)
+        {
+            const Node* tmp = file.readonly(address[i]);
+            const Code* found = lower_bound(tmp->key, tmp->key+tmp->size, codes[i], comp);
+            if (found != tmp->key+tmp->size && *found == codes[i])
+                address[num++] = tmp->ptr[found - tmp->key];
+        }
+        data.prefetch(address, num);
+    }
+
     void insert(const K& key, const V& value)
     {
+        const Code& code = Key_Code<K>::encode(key);
+        filter.insert(code);
         if (!head)
         {
             Node tmp;
@@ -55,19 +93,24 @@ public:
             tmp.parent = 0;
             tmp.isleaf = true;
             tmp.size = 1;
-            tmp.key[0] = key;
+            tmp.key[0] = code;
+            tmp.ptr[DEGREE] = 0;
             tmp.ptr[0] = data.new_space();
             data.write(tmp.ptr[0], value);
             file.write(head, tmp);
             return;
         }
-        insert_leaf(find_Node(key), key, value);
+        insert_leaf(find_Node(code), code, value);
     }
 
     void erase(const K& key)
     {
         if (!head) return;
-        erase_leaf(find_Node(key), key);
+        const Code& code = Key_Code<K>::encode(key);
+        erase_leaf(find_Node(code), code);
+        filter.erase(code);
+        if (filter.need_rebuild())
+            rebuild_filter();
     }
 
     bool empty() const
@@ -80,41 +123,61 @@ public:
     {
         file.clean();
         data.clean();
+        filter.clean();
         head = 0;
     }
 
 private:
-    constexpr static int DEGREE = 4000 / (sizeof(long) + sizeof(K));
+    typedef typename Key_Code<K>::code Code;
+    constexpr static int DEGREE = 4000 / (sizeof(long) + sizeof(Code));
     struct Node
     {
         int size;
         bool isleaf;
         long parent;
-        K key[DEGREE];
+        Code key[DEGREE];
         long ptr[DEGREE+1]; // leaf's ptr[DEGREE] points to next leaf
     };
     long head = 0;
     Comp comp;
     Myfile<Node, long> file;
     Datafile<V> data;
+    Filter<Code> filter;
+
+    // refill the filter with all keys in leaves
+    void rebuild_filter()
+    {
+        filter.clean();
+        if (!head) return;
+        const Node* tmp = file.readonly(head);
+        while (!tmp->isleaf)
+            tmp = file.readonly(tmp->ptr[0]);
+        while (true)
+        {
+            for (int i = 0; i < tmp->size; i++)
+                filter.insert(tmp->key[i]);
+            if (!tmp->ptr[DEGREE]) return;
+            tmp = file.readonly(tmp->ptr[DEGREE]);
+        }
+    }
 
-    long find_Node(const K& key)
+    long find_Node(const Code& key)
     {
         long res = head;
         const Node* tmp = file.readonly(head);
         while (!tmp->isleaf)
         {
-            const K* found = upper_bound(tmp->key, tmp->key+tmp->size, key, comp);
+            const Code* found = upper_bound(tmp->key, tmp->key+tmp->size, key, comp);
             res = tmp->ptr[found - tmp->key];
             tmp = file.readonly(res);
         }
         return res;
     }
 
-    void insert_leaf(long address, const K& key, const V& value)
+    void insert_leaf(long address, const Code& key, const V& value)
     {
         Node& tmp = *file.readwrite(address);
-        K* found = lower_bound(tmp.key, tmp.key+tmp.size, key, comp);
+        Code* found = lower_bound(tmp.key, tmp.key+tmp.size, key, comp);
         if (found != tmp.key+tmp.size && *found == key) return; // remember to check out_of_bound!
         int locat = found - tmp.key;
         for (int i = tmp.size; i > locat; i--)
@@ -146,7 +209,7 @@ private:
         insert_internal(tmp.parent, new_address, tmp.key[carry]);
     }
 
-    void insert_internal(long this_address, long right_address, const K& toinsert)
+    void insert_internal(long this_address, long right_address, const Code& toinsert)
     {
         if (!this_address)
         {
@@ -167,7 +230,7 @@ private:
             return;
         }
         Node& this_node = *file.readwrite(this_address);
-        K* found = lower_bound(this_node.key, this_node.key+this_node.size, toinsert, comp);
+        Code* found = lower_bound(this_node.key, this_node.key+this_node.size, toinsert, comp);
         int locat = found - this_node.key;
         if (this_node.size < DEGREE)
         {
@@ -183,7 +246,7 @@ private:
         }
         // split
         int carry = DEGREE / 2;
-        K tocarry = this_node.key[carry];
+        Code tocarry = this_node.key[carry];
         long new_address = file.new_space();
         Node new_node;
         new_node.isleaf = false;
@@ -229,11 +292,11 @@ private:
         insert_internal(this_node.parent, new_address, tocarry);
     }
 
-    void erase_leaf(long address, const K& key)
+    void erase_leaf(long address, const Code& key)
     {
         
         Node &tmp = *file.readwrite(address);
-        K* found = lower_bound(tmp.key, tmp.key+tmp.size, key, comp);
+        Code* found = lower_bound(tmp.key, tmp.key+tmp.size, key, comp);
         if (!(*found == key)) return;
         int locat = found - tmp.key;
         if (locat == tmp.size) return;
@@ -258,7 +321,7 @@ private:
             return;
         }
         Node &parent_node = *file.readwrite(this_node.parent);
-        K* this_key = upper_bound(parent_node.key, parent_node.key+parent_node.size, this_node.key[0], comp) - 1;
+        Code* this_key = upper_bound(parent_node.key, parent_node.key+parent_node.size, this_node.key[0], comp) - 1;
         int locat = this_key - parent_node.key;
         // borrow from right sibling
         long right;
@@ -360,7 +423,7 @@ private:
             return;
         }
         Node &parent_node = *file.readwrite(this_node.parent);
-        K* this_key = upper_bound(parent_node.key, parent_node.key+parent_node.size, this_node.key[0], comp) - 1;
+        Code* this_key = upper_bound(parent_node.key, parent_node.key+parent_node.size, this_node.key[0], comp) - 1;
         int locat = this_key - parent_node.key;
         long right;
         if (locat == parent_node.size - 1)
@@ -3,13 +3,15 @@
 #define MULTI_BPT_HPP
 
 #include "../file/Myfile.hpp"
+#include "../file/Keycode.hpp"
 #include "../STLite/vector.hpp"
 #include "../STLite/algorithm.hpp"
 
 namespace sjtu
 {
 
-template<typename K, typename V, class Comp_K = std::less<K>, class Comp_V = std::less<V>>
+// keys are stored in nodes as Key_Code<K>::code
+template<typename K, typename V, class Comp_K = std::less<typename Key_Code<K>::code>, class Comp_V = std::less<V>>
 class Multi_BPT
 {
 public:
@@ -22,11 +24,14 @@ public:
         file.head() = head;
     }
 
-    void find(const K& key, vector<V>& res)
+    void find(const K& k, vector<V>& res)
     {
         if (!head) return;
+        const Code& key = Key_Code<K>::encode(k);
         const Node* tmp;
-        long tofind = find_Node(key);
+        long siblings[MAX_BATCH];
+        int sibling_num = 0;
+        long tofind = find_Node(key, siblings, sibling_num);
         tmp = file.readonly(tofind);
         const KVpair* begin = lower_bound(tmp->data, tmp->data+tmp->size, key, comp);
         int locat = begin - tmp->data;
@@ -37,6 +42,13 @@ public:
             else return;
         }
         long next = tmp->ptr[1];
+        // the rest of the chain under the same parent is read in one batch
+        if (next && sibling_num)
+        {
+            file.prefetch(siblings, sibling_num);
+            tmp = file.readonly(tofind);
+            next = tmp->ptr[1];
+        }
         while (next)
         {
             tmp = file.readonly(next);
@@ -51,8 +63,29 @@ public:
         }
     }
 
-    void insert(const K& key, const V& value)
+    // the values of the keys in [lo, hi), in the order of key then value
+    void find_range(const K& lo, const K& hi, vector<V>& res)
+    {
+        if (!head) return;
+        const Code& low = Key_Code<K>::encode(lo);
+        const Code& high = Key_Code<K>::encode(hi);
+        const Node* tmp = file.readonly(find_Node(low));
+        while (true)
+        {
+            for (int i = 0; i < tmp->size; i++)
+            {
+                if (tmp->data[i].key < low) continue;
+                if (!(tmp->data[i].key < high)) return;
+                res.push_back(tmp->data[i].value);
+            }
+            if (!tmp->ptr[1]) return;
+            tmp = file.readonly(tmp->ptr[1]);
+        }
+    }
+
+    void insert(const K& k, const V& value)
     {
+        const Code& key = Key_Code<K>::encode(k);
         if (!head)
         {
             Node tmp;
@@ -68,9 +101,10 @@ public:
         insert_leaf(find_Node(key, value), key, value);
     }
 
-    void erase(const K& key, const V& value)
+    void erase(const K& k, const V& value)
     {
         if (!head) return;
+        const Code& key = Key_Code<K>::encode(k);
         erase_leaf(find_Node(key, value), key, value);
     }
 
@@ -81,13 +115,14 @@ public:
     }
 
 private:
-    constexpr static int DEGREE = 4000 / (sizeof(long) + sizeof(K) + sizeof(V));
+    typedef typename Key_Code<K>::code Code;
+    constexpr static int DEGREE = 4000 / (sizeof(long) + sizeof(Code) + sizeof(V));
     struct KVpair
     {
-        K key;
+        Code key;
         V value;
         KVpair() {}
-        KVpair(const K& k, const V& v): key(k), value(v) {}
+        KVpair(const Code& k, const V& v): key(k), value(v) {}
         friend bool operator==(const KVpair& a, const KVpair& b)
         {
             return a.key == b.key && a.value == b.value;
@@ -104,11 +139,11 @@ private:
     {
         Comp_K comp_k;
         Comp_V comp_v;
-        bool operator()(const KVpair& x, const K& key)
+        bool operator()(const KVpair& x, const Code& key)
         {
             return comp_k(x.key, key);
         }
-        bool operator()(const K& key, const KVpair& x)
+        bool operator()(const Code& key, const KVpair& x)
         {
             return comp_k(key, x.key);
         }
@@ -121,7 +156,7 @@ private:
     long head = 0;
     Myfile<Node, long> file;
 
-    long find_Node(const K& key, const V& value)
+    long find_Node(const Code& key, const V& value)
     {
         long res = head;
         const Node* tmp = file.readonly(head);
@@ -135,7 +170,7 @@ private:
         return res;
     }
 
-    long find_Node(const K& key)
+    long find_Node(const Code& key)
     {
         long res = head;
         const Node* tmp = file.readonly(head);
@@ -148,7 +183,25 @@ private:
         return res;
     }
 
-    void insert_leaf(long address, const K& key, const V& value)
+    // also give the right siblings of the leaf that may hold key
+    long find_Node(const Code& key, long* siblings, int& sibling_num)
+    {
+        long res = head;
+        const Node* tmp = file.readonly(head);
+        while (tmp->ptr[0])
+        {
+            const KVpair* found = lower_bound(tmp->data, tmp->data+tmp->size, key, comp);
+            int locat = found - tmp->data;
+            res = tmp->ptr[locat];
+            sibling_num = 0;
+            for (int i = locat; i < tmp->size && sibling_num < MAX_BATCH && tmp->data[i].key == key; i++)
+                siblings[sibling_num++] = tmp->ptr[i+1];
+            tmp = file.readonly(res);
+        }
+        return res;
+    }
+
+    void insert_leaf(long address, const Code& key, const V& value)
     {
         Node& tmp = *file.readwrite(address);
         KVpair toinsert(key, value);
@@ -257,7 +310,7 @@ private:
         insert_internal(this_node.parent, new_address, tocarry);
     }
 
-    void erase_leaf(long address, const K& key, const V& value)
+    void erase_leaf(long address, const Code& key, const V& value)
     {
         
         KVpair toerase(key, value);
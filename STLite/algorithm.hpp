@@ -97,6 +97,39 @@ void innersort(T* first, T* last, Compare comp, T* tmp)
 		first[i] = tmp[i];
 }
 
+// heaps have the greatest element under comp at begin
+// sift *(end-1) up into the heap [begin, end-1)
+template<typename T, typename Compare>
+void push_heap(T* begin, T* end, Compare comp)
+{
+    int i = end - begin - 1;
+    while (i > 0)
+    {
+        int parent = (i - 1) >> 1;
+        if (!comp(begin[parent], begin[i])) return;
+        std::swap(begin[parent], begin[i]);
+        i = parent;
+    }
+}
+
+// move *begin to end-1 and keep [begin, end-1) a heap
+template<typename T, typename Compare>
+void pop_heap(T* begin, T* end, Compare comp)
+{
+    int size = end - begin - 1;
+    std::swap(begin[0], begin[size]);
+    int i = 0;
+    while (true)
+    {
+        int child = 2 * i + 1;
+        if (child >= size) return;
+        if (child + 1 < size && comp(begin[child], begin[child+1])) child++;
+        if (!comp(begin[i], begin[child])) return;
+        std::swap(begin[i], begin[child]);
+        i = child;
+    }
+}
+
 } // namespace sjtu
 
 # endif
@@ -3,6 +3,7 @@
 # define SJTU_ALLOCATOR_HPP
 
 #include <iostream>
+#include <cstdlib>
 
 namespace sjtu
 {
@@ -13,7 +14,7 @@ class allocator
 public:
     allocator()
     {
-        space = (T*) malloc(size * sizeof(T));
+        space = (T*) aligned_alloc(alignof(T), size * sizeof(T));
     }
     ~allocator()
     {
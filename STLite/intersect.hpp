@@ -0,0 +1,112 @@
+// intersection of sorted posting lists
+#ifndef SJTU_INTERSECT_HPP
+#define SJTU_INTERSECT_HPP
+
+#include "vector.hpp"
+#include "utility.hpp"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GALLOP_RATIO 32 // galloping is used when one list is this many times longer
+
+namespace sjtu
+{
+
+namespace posting
+{
+
+// values are compared by value >> shift, and keys are unique in each list
+// res gets pairs of positions in a and b with equal keys, in order
+
+inline void merge(const int* a, int na, const int* b, int nb, int shift, vector<pair<int, int>>& res, int i = 0, int j = 0)
+{
+    while (i < na && j < nb)
+    {
+        int x = a[i] >> shift, y = b[j] >> shift;
+        if (x < y) i++;
+        else if (y < x) j++;
+        else res.push_back(pair<int, int>(i++, j++));
+    }
+}
+
+// a is the short list, look up each of it in b by exponential search
+inline void gallop(const int* a, int na, const int* b, int nb, int shift, vector<pair<int, int>>& res, bool swapped)
+{
+    int j = 0;
+    for (int i = 0; i < na && j < nb; i++)
+    {
+        int x = a[i] >> shift;
+        int step = 1, hi = j;
+        while (hi < nb && (b[hi] >> shift) < x)
+        {
+            j = hi + 1;
+            hi += step;
+            step <<= 1;
+        }
+        if (hi > nb) hi = nb;
+        // the first key >= x is in [j, hi]
+        while (j < hi)
+        {
+            int mid = (j + hi) >> 1;
+            if ((b[mid] >> shift) < x) j = mid + 1;
+            else hi = mid;
+        }
+        if (j < nb && (b[j] >> shift) == x)
+        {
+            if (swapped) res.push_back(pair<int, int>(j, i));
+            else res.push_back(pair<int, int>(i, j));
+            j++;
+        }
+    }
+}
+
+#ifdef __SSE2__
+// compare blocks of 4 against blocks of 4, finishing the rest by merge
+inline void block(const int* a, int na, const int* b, int nb, int shift, vector<pair<int, int>>& res)
+{
+    int i = 0, j = 0;
+    __m128i count = _mm_cvtsi32_si128(shift);
+    while (i + 4 <= na && j + 4 <= nb)
+    {
+        __m128i va = _mm_sra_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), count);
+        __m128i vb = _mm_sra_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j)), count);
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4e)), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+        if (_mm_movemask_epi8(m))
+        {
+            for (int p = 0; p < 4; p++)
+                for (int q = 0; q < 4; q++)
+                    if ((a[i+p] >> shift) == (b[j+q] >> shift))
+                        res.push_back(pair<int, int>(i + p, j + q));
+        }
+        int amax = a[i+3] >> shift, bmax = b[j+3] >> shift;
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+    merge(a, na, b, nb, shift, res, i, j);
+}
+#endif
+
+} // namespace posting
+
+// pick merge, galloping or block comparison by the sizes of the lists
+inline void intersect(const int* a, int na, const int* b, int nb, int shift, vector<pair<int, int>>& res)
+{
+    if (!na || !nb) return;
+    if (na * GALLOP_RATIO < nb)
+        posting::gallop(a, na, b, nb, shift, res, false);
+    else if (nb * GALLOP_RATIO < na)
+        posting::gallop(b, nb, a, na, shift, res, true);
+#ifdef __SSE2__
+    else if (na >= 4 && nb >= 4)
+        posting::block(a, na, b, nb, shift, res);
+#endif
+    else
+        posting::merge(a, na, b, nb, shift, res);
+}
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,64 @@
+// random and sequential reads through the page cache, build with and without DIRECT_IO to compare
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include "../file/Seatfile.hpp"
+
+#define BENCH_PAGES 20000 // 80 MB of pages, far more than MAX_CACHE
+#define BENCH_READS 200000
+#define BENCH_ROW 126 // ints in the seat row of a 99-station train
+
+using namespace sjtu;
+
+template<typename F>
+double seconds(F f)
+{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void bench()
+{
+    Seatfile file("bench_page_io");
+    long size = (long)BENCH_PAGES * 1000; // ints of a page
+    long base = file.new_space(size);
+    static int row[BENCH_ROW];
+    // pages are made on the first write, so write them all before reading
+    static int page[1000];
+    for (long pos = 0; pos < size; pos += 1000)
+        file.write(base + pos, page, 1000);
+    std::mt19937 rng(2022);
+    long sum = 0;
+    double random_read = seconds([&]
+    {
+        for (int i = 0; i < BENCH_READS; i++)
+        {
+            file.read(base + rng() % (size - BENCH_ROW), row, BENCH_ROW);
+            sum += row[0];
+        }
+    });
+    double sequential_read = seconds([&]
+    {
+        for (long pos = 0; pos + BENCH_ROW <= size; pos += BENCH_ROW)
+        {
+            file.read(base + pos, row, BENCH_ROW);
+            sum += row[0];
+        }
+    });
+#ifdef DIRECT_IO
+    const char* mode = "direct";
+#else
+    const char* mode = "buffered";
+#endif
+    printf("%s: random %.2f us/read, sequential %.1f MB/s (%ld)\n", mode,
+           random_read * 1e6 / BENCH_READS, size * sizeof(int) / sequential_read / 1e6, sum);
+}
+
+int main()
+{
+    remove("bench_page_io.db");
+    bench();
+    remove("bench_page_io.db");
+    return 0;
+}
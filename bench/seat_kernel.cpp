@@ -0,0 +1,78 @@
+// range max and range add on the seat row of a 99-station train, through Seat_Row with each kernel
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include "../seat.hpp"
+
+#define BENCH_OPS 2000000
+#define BENCH_LEN 99 // sections of the row
+#define BENCH_ROUNDS 5 // the best round is printed
+
+using namespace sjtu;
+
+static int from[BENCH_OPS], to[BENCH_OPS];
+
+// the loops the kernels replaced, on seats left rather than sold
+int naive(int* s, int f, int t, int n)
+{
+    int left = 1 << 30;
+    for (int i = f; i < t; i++)
+        left = std::min(left, s[i]);
+    if (left >= n)
+        for (int i = f; i < t; i++)
+            s[i] -= n;
+    return left;
+}
+
+// ns per op of the best round
+template<typename Op>
+void run(const char* name, Op op)
+{
+    double best = 1e18;
+    long sum = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < BENCH_OPS; i++)
+            sum += op(from[i], to[i]);
+        best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count());
+    }
+    printf("%-8s %6.1f ns/op (%ld)\n", name, best / BENCH_OPS, sum);
+}
+
+// a sale is a max then an add on [f, t), as in buy_ticket
+void run_row(const char* name, int (*max)(const int*, int, int), void (*add)(int*, int, int))
+{
+    Seat_Kernel::instance().max = max;
+    Seat_Kernel::instance().add = add;
+    Seat_Row<BENCH_LEN> row(BENCH_LEN);
+    for (int i = 0; i < row.size(); i++) row.data()[i] = 0;
+    run(name, [&](int f, int t)
+    {
+        int res = row.max(f, t);
+        row.add(f, t, res & 1 ? -1 : 1);
+        return res;
+    });
+}
+
+int main()
+{
+    std::mt19937 rng(2022);
+    for (int i = 0; i < BENCH_OPS; i++)
+    {
+        from[i] = rng() % BENCH_LEN;
+        to[i] = from[i] + 1 + rng() % (BENCH_LEN - from[i]);
+    }
+    static int left[BENCH_LEN];
+    for (int i = 0; i < BENCH_LEN; i++) left[i] = BENCH_OPS * BENCH_ROUNDS;
+    run("naive", [](int f, int t) { return naive(left, f, t, 1); });
+    run_row("scalar", kernel::max_scalar, kernel::add_scalar);
+#ifdef SEAT_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1"))
+        run_row("sse4.1", kernel::max_sse, kernel::add_sse);
+    if (__builtin_cpu_supports("avx2"))
+        run_row("avx2", kernel::max_avx2, kernel::add_avx2);
+#endif
+    return 0;
+}
@@ -0,0 +1,125 @@
+// an output buffer kept between commands, flushed in one write
+#ifndef BUFFER_HPP
+#define BUFFER_HPP
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "file/Mystring.hpp"
+#include "date.hpp"
+
+namespace sjtu
+{
+
+class Buffer
+{
+public:
+    Buffer(): data((char*)malloc(64)), cap(64) {}
+    ~Buffer()
+    {
+        free(data);
+    }
+
+    Buffer& operator<<(char c)
+    {
+        reserve(1);
+        data[len++] = c;
+        return *this;
+    }
+
+    Buffer& operator<<(const char* s)
+    {
+        int n = strlen(s);
+        reserve(n);
+        memcpy(data + len, s, n);
+        len += n;
+        return *this;
+    }
+
+    template<int size>
+    Buffer& operator<<(const Mystring<size>& s)
+    {
+        return *this << s.string;
+    }
+
+    Buffer& operator<<(long long x)
+    {
+        char tmp[24];
+        int n = 0;
+        bool neg = x < 0;
+        unsigned long long y = neg ? -(unsigned long long)x : x;
+        do
+        {
+            tmp[n++] = '0' + y % 10;
+            y /= 10;
+        } while (y);
+        reserve(n + 1);
+        if (neg) data[len++] = '-';
+        while (n) data[len++] = tmp[--n];
+        return *this;
+    }
+
+    Buffer& operator<<(int x)
+    {
+        return *this << (long long)x;
+    }
+
+    Buffer& operator<<(Date x)
+    {
+        reserve(5);
+        two_digits(x.month());
+        data[len++] = '-';
+        two_digits(x.day());
+        return *this;
+    }
+
+    Buffer& operator<<(Time x)
+    {
+        reserve(5);
+        two_digits(x.m / 60);
+        data[len++] = ':';
+        two_digits(x.m % 60);
+        return *this;
+    }
+
+    int size() const
+    {
+        return len;
+    }
+
+    const char* c_str()
+    {
+        reserve(1);
+        data[len] = '\0';
+        return data;
+    }
+
+    // write out and empty, keeping the memory
+    void flush(std::ostream& out)
+    {
+        out.write(data, len);
+        len = 0;
+    }
+
+private:
+    char* data;
+    int cap;
+    int len = 0;
+
+    void reserve(int n)
+    {
+        if (len + n <= cap) return;
+        while (cap < len + n) cap <<= 1;
+        data = (char*)realloc(data, cap);
+    }
+
+    inline void two_digits(int x)
+    {
+        data[len++] = '0' + x / 10;
+        data[len++] = '0' + x % 10;
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -2,182 +2,178 @@
 #ifndef DATE_HPP
 #define DATE_HPP
 
+#include <cassert>
 #include <iostream>
 #include <string>
+#include "file/Keycode.hpp"
 
 namespace sjtu
 {
 
+// days before each month of a common year
+constexpr short month_start[13] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365};
+
 struct Date
 {
-    char m;
-    char d;
+    short n; // days from 01-01
 
     Date() {}
     Date(const std::string& s)
     {
-        m = 10 * (s[0] - '0') + s[1] - '0';
-        d = 10 * (s[3] - '0') + s[4] - '0';
+        int m = 10 * (s[0] - '0') + s[1] - '0';
+        int d = 10 * (s[3] - '0') + s[4] - '0';
+        n = month_start[m-1] + d - 1;
+    }
+
+    // the day of its own year, for dates an arrival carries past 12-31 or before 01-01
+    inline int day_of_year() const
+    {
+        return (n % month_start[12] + month_start[12]) % month_start[12];
+    }
+
+    // no month starts later than 31 days a month would
+    inline int month() const
+    {
+        int k = day_of_year(), m = k / 31;
+        while (m < 11 && month_start[m+1] <= k) ++m;
+        return m + 1;
+    }
+
+    inline int day() const
+    {
+        return day_of_year() - month_start[month()-1] + 1;
     }
 
     inline void operator++()
     {
-        if (++d < 31) return;
-        if (d == 31)
-        {
-            if (m == 6)
-            {
-                ++m;
-                d = 1;
-                return;
-            }
-            return;
-        } 
-        ++m;
-        d = 1;
+        ++n;
     }
 
     inline void operator+=(int x)
     {
-        d += x;
-        if (d < 31) return;
-        if (d == 31)
-        {
-            if (m == 6)
-            {
-                ++m;
-                d -= 30;
-            }
-            return;
-        }
-        ++m;
-        d -= 31;
+        n += x;
     }
 
     inline Date operator+(int x) const
     {
         Date res = *this;
-        res += x;
+        res.n += x;
         return res;
     }
 
     inline void operator--()
     {
-        if (--d > 0) return;
-        --m;
-        if (m == 6)
-        {
-            d = 30;
-            return;
-        }
-        d = 31;
+        --n;
     }
 
     inline void operator-=(int x)
     {
-        if (d > x)
-        {
-            d -= x;
-            return;
-        }
-        --m;
-        d += 31;
-        if (m == 6)  --d;
-        d -= x;
+        n -= x;
     }
 
     inline Date operator-(int x) const
     {
         Date res = *this;
-        res -= x;
+        res.n -= x;
         return res;
     }
 
     inline friend bool operator<(Date a, Date b)
     {
-        if (a.m != b.m) return a.m < b.m;
-        return a.d < b.d;
+        return a.n < b.n;
     }
 
     inline friend bool operator==(Date a, Date b)
     {
-        return a.m == b.m && a.d == b.d;
+        return a.n == b.n;
     }
 
     friend std::ostream& operator<<(std::ostream& out, Date x)
     {
-        out << x.m / 10 << x.m % 10 << '-' << x.d / 10 << x.d % 10;
+        int m = x.month(), d = x.day();
+        out << m / 10 << m % 10 << '-' << d / 10 << d % 10;
         return out;
     }
 
     friend int operator-(Date a, Date b)
     {
-        int res = 0;
-        while (a.m > b.m)
-        {
-            res += a.d;
-            a.d = 1;
-            --a;
-        }
-        return res + a.d - b.d;
+        return a.n - b.n;
     }
 };
 
+// minutes, counted from the midnight of the departure date in a timetable
 struct Time
-{   
-    char h;
-    char m;
+{
+    int m;
 
     Time() {}
     Time(const std::string& s)
     {
-        h = 10 * (s[0] - '0') + s[1] - '0';
-        m = 10 * (s[3] - '0') + s[4] - '0';
+        m = (10 * (s[0] - '0') + s[1] - '0') * 60 + 10 * (s[3] - '0') + s[4] - '0';
     }
 
-    Time operator+(int x)
+    // days after the departure date
+    inline int day() const
+    {
+        return m / 1440;
+    }
+
+    // the time of that day
+    inline Time clock() const
+    {
+        Time res;
+        res.m = m % 1440;
+        return res;
+    }
+
+    Time operator+(int x) const
     {
         Time res;
-        res.h = h;
-        x += m;
-        res.h += x / 60;
-        res.m = x % 60;
+        res.m = m + x;
         return res;
     }
 
     void operator+=(int x)
     {
-        x += m;
-        h += x / 60;
-        m = x % 60;
+        m += x;
     }
 
     int operator-(Time other) const
     {
-        return (h - other.h) * 60 + m - other.m;
+        return m - other.m;
     }
 
     friend std::ostream& operator<<(std::ostream& out, Time x)
     {
-        out << x.h / 10 << x.h % 10 << ':' << x.m / 10 << x.m % 10;
+        int h = x.m / 60, m = x.m % 60;
+        out << h / 10 << h % 10 << ':' << m / 10 << m % 10;
         return out;
     }
 
     friend bool operator<(Time a, Time b)
     {
-        if (a.h != b.h) return a.h < b.h;
         return a.m < b.m;
     }
 
 };
 
-void adjust_date(Date& d, Time& t)
+template<>
+struct Key_Code<Date>
 {
-    while (t.h >= 24)
+    typedef Keycode<2> code;
+    static code encode(Date x)
     {
-        ++d;
-        t.h -= 24;
+        assert(x.n >= 0); // encoded unsigned
+        code res;
+        encode_uint(res.byte, x.n, 2);
+        return res;
     }
+};
+
+void adjust_date(Date& d, Time& t)
+{
+    d += t.day();
+    t = t.clock();
 }
 
 // (d1, t1) should be earlier than (d2, t2)
@@ -185,7 +181,7 @@ int time_between(Date d1, Time t1, Date d2, Time t2)
 {
     if (t2 < t1)
     {
-        t2.h += 24;
+        t2 += 1440;
         --d2;
     }
     return (d2 - d1) * 1440 + (t2 - t1);
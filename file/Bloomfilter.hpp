@@ -0,0 +1,127 @@
+// a persisted bloom filter to skip lookups of absent keys
+#ifndef BLOOMFILTER_HPP
+#define BLOOMFILTER_HPP
+
+#include <fstream>
+#include <cstring>
+#include <string>
+
+#define BLOOM_BITS (1 << 20)
+#define BLOOM_HASH 6
+
+namespace sjtu
+{
+
+// default filter of BPT: every key may exist
+template<typename K>
+class No_Filter
+{
+public:
+    No_Filter(const std::string& name) {}
+    ~No_Filter() = default;
+
+    void insert(const K& key) {}
+    void erase(const K& key) {}
+    bool may_contain(const K& key) const
+    {
+        return true;
+    }
+    bool need_rebuild() const
+    {
+        return false;
+    }
+    void clean() {}
+};
+
+// K should provide hash(const K&) found by ADL
+template<typename K>
+class Bloom_Filter
+{
+public:
+    Bloom_Filter(const std::string& _name): name(_name)
+    {
+        bits = new unsigned long long[WORDS];
+        std::fstream file(name + ".db", std::ios::in | std::ios::binary);
+        if (file.good())
+        {
+            file.read(reinterpret_cast <char *> (&count), sizeof(long));
+            file.read(reinterpret_cast <char *> (&erased), sizeof(long));
+            file.read(reinterpret_cast <char *> (bits), WORDS * sizeof(unsigned long long));
+            valid = file.good();
+        }
+        if (!valid)
+        {
+            memset(bits, 0, WORDS * sizeof(unsigned long long));
+            count = erased = 0;
+        }
+    }
+
+    ~Bloom_Filter()
+    {
+        std::fstream file(name + ".db", std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast <char *> (&count), sizeof(long));
+        file.write(reinterpret_cast <char *> (&erased), sizeof(long));
+        file.write(reinterpret_cast <char *> (bits), WORDS * sizeof(unsigned long long));
+        delete []bits;
+    }
+
+    void insert(const K& key)
+    {
+        unsigned long long h1, h2;
+        split(key, h1, h2);
+        for (int i = 0; i < BLOOM_HASH; i++, h1 += h2)
+            bits[(h1 % BLOOM_BITS) >> 6] |= 1ULL << (h1 & 63);
+        ++count;
+    }
+
+    // bits can not be cleared, only count the garbage
+    void erase(const K& key)
+    {
+        ++erased;
+    }
+
+    bool may_contain(const K& key) const
+    {
+        unsigned long long h1, h2;
+        split(key, h1, h2);
+        for (int i = 0; i < BLOOM_HASH; i++, h1 += h2)
+            if (!(bits[(h1 % BLOOM_BITS) >> 6] & (1ULL << (h1 & 63))))
+                return false;
+        return true;
+    }
+
+    // missing file or too many erased keys
+    bool need_rebuild() const
+    {
+        return !valid || erased * 2 > count;
+    }
+
+    void clean()
+    {
+        memset(bits, 0, WORDS * sizeof(unsigned long long));
+        count = erased = 0;
+        valid = true;
+    }
+
+private:
+    constexpr static int WORDS = BLOOM_BITS / 64;
+    unsigned long long* bits;
+    long count = 0;
+    long erased = 0;
+    bool valid = false;
+    std::string name;
+
+    static void split(const K& key, unsigned long long& h1, unsigned long long& h2)
+    {
+        unsigned long long h = hash(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h1 = h;
+        h2 = (h >> 32) | 1;
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -11,79 +11,177 @@ template<typename V>
 class Datafile
 {
 public:
-    Datafile(const std::string& name): file(name, pos)
+    Datafile(const std::string& name): file(name, info)
     {
-        pos = file.head();
-        if (!pos)
-        {
-            Block tmp;
-            pos = file.new_space();
-            file.write(pos, tmp);
-        }
+        info = file.head();
+        if (!info.pos)
+            new_tail();
     }
     ~Datafile()
     {
-        file.head() = pos;
+        file.head() = info;
     }
-    
+
+    // reuse a freed slot first, then the tail block
     long new_space()
     {
-        Block* tmp = file.readwrite(pos);
-        if (tmp->size < MAXSIZE)
-            return pos + (tmp->size++) * sizeof(V);
-        Block new_block;
-        new_block.size++;
-        pos = file.new_space();
-        file.write(pos, new_block);
-        return pos;
+        long address = info.free_block ? info.free_block : info.pos;
+        Block* tmp = file.readwrite(address);
+        if (tmp->free_slot != -1)
+        {
+            int slot = tmp->free_slot;
+            memcpy(&tmp->free_slot, reinterpret_cast<char*>(tmp->data + slot), sizeof(int));
+            tmp->size++;
+            info.used++;
+            if (tmp->free_slot == -1 && tmp->listed)
+                unlink(address, tmp);
+            return address + slot * sizeof(V);
+        }
+        if (tmp->top < MAXSIZE)
+        {
+            tmp->size++;
+            info.used++;
+            return address + (tmp->top++) * sizeof(V);
+        }
+        new_tail();
+        tmp = file.readwrite(info.pos);
+        tmp->size++;
+        tmp->top++;
+        info.used++;
+        return info.pos;
     }
 
     void delete_space(long address)
     {
-        long offset = (address - 3 * sizeof(long)) % sizeof(Block);
-        long block_address = address - offset;
+        long block_address = block_of(address);
+        int slot = (address - block_address) / sizeof(V);
         Block* block = file.readwrite(block_address);
-        if (--block->size) return;
-        if (block_address != pos)
+        info.used--;
+        if (!--block->size && block_address != info.pos)
+        {
+            if (block->listed)
+                unlink(block_address, block);
             file.delete_space(block_address);
+            info.blocks--;
+            return;
+        }
+        memcpy(reinterpret_cast<char*>(block->data + slot), &block->free_slot, sizeof(int));
+        block->free_slot = slot;
+        if (!block->listed && block_address != info.pos)
+            link(block_address, block);
     }
 
     void write(long address, const V& value)
     {
-        long offset = (address - 3 * sizeof(long)) % sizeof(Block);
-        Block* block = file.readwrite(address - offset);
-        block->data[offset / sizeof(V)] = value;
+        long block_address = block_of(address);
+        Block* block = file.readwrite(block_address);
+        block->data[(address - block_address) / sizeof(V)] = value;
     }
 
     const V* readonly(long address)
     {
-        long offset = (address - 3 * sizeof(long)) % sizeof(Block);
-        const Block* block = file.readonly(address - offset);
-        return (block->data + offset / sizeof(V));
+        long block_address = block_of(address);
+        const Block* block = file.readonly(block_address);
+        return (block->data + (address - block_address) / sizeof(V));
     }
 
     V* readwrite(long address)
     {
-        long offset = (address - 3 * sizeof(long)) % sizeof(Block);
-        Block* block = file.readwrite(address - offset);
-        return (block->data + offset / sizeof(V));
+        long block_address = block_of(address);
+        Block* block = file.readwrite(block_address);
+        return (block->data + (address - block_address) / sizeof(V));
+    }
+
+    // load the blocks of the given values together
+    void prefetch(const long* addresses, int n)
+    {
+        long blocks[MAX_BATCH];
+        int size = 0;
+        for (int i = 0; i < n && size < MAX_BATCH; i++)
+            blocks[size++] = block_of(addresses[i]);
+        file.prefetch(blocks, size);
+    }
+
+    // number of values stored
+    long size() const
+    {
+        return info.used;
+    }
+
+    // number of slots in allocated blocks
+    long capacity() const
+    {
+        return info.blocks * MAXSIZE;
+    }
+
+    double fill_factor() const
+    {
+        return info.blocks ? (double)info.used / capacity() : 0;
     }
 
     void clean()
     {
         file.clean();
-        pos = 0;
+        info = Info();
+        new_tail();
     }
 
 private:
     constexpr static int MAXSIZE = std::max(4000/sizeof(V), 1UL);
+    static_assert(sizeof(V) >= sizeof(int), "a free slot keeps the next free slot in it");
     struct Block
     {
         V data[MAXSIZE];
-        int size = 0;
+        int size = 0; // slots in use
+        int top = 0; // slots ever handed out
+        int free_slot = -1; // head of the freed slots in this block
+        bool listed = false; // whether in the list of blocks with free slots
+        long pre_free = 0;
+        long next_free = 0;
     };
-    long pos = 0;
-    Myfile<Block, long> file;
+    struct Info
+    {
+        long pos = 0; // tail block
+        long free_block = 0; // head of the list of blocks with free slots
+        long blocks = 0;
+        long used = 0;
+    };
+    Info info;
+    Myfile<Block, Info> file;
+
+    inline long block_of(long address) const
+    {
+        return address - (address - file.BASE) % file.STRIDE;
+    }
+
+    void new_tail()
+    {
+        Block tmp;
+        info.pos = file.new_space();
+        info.blocks++;
+        file.write(info.pos, tmp);
+    }
+
+    void link(long address, Block* block)
+    {
+        block->listed = true;
+        block->pre_free = 0;
+        block->next_free = info.free_block;
+        if (info.free_block)
+            file.readwrite(info.free_block)->pre_free = address;
+        info.free_block = address;
+    }
+
+    void unlink(long address, Block* block)
+    {
+        block->listed = false;
+        if (block->pre_free)
+            file.readwrite(block->pre_free)->next_free = block->next_free;
+        else
+            info.free_block = block->next_free;
+        if (block->next_free)
+            file.readwrite(block->next_free)->pre_free = block->pre_free;
+    }
 };
 
 }// namespace sjtu
@@ -0,0 +1,85 @@
+// a persistent dictionary giving strings dense int ids
+#ifndef DICTIONARY_HPP
+#define DICTIONARY_HPP
+
+#include "Myfile.hpp"
+#include "Mystring.hpp"
+#include "../B_plus_tree/BPT.hpp"
+
+namespace sjtu
+{
+
+template<int size>
+class Dictionary
+{
+public:
+    Dictionary(const std::string& name): ids(name + "_id"), names(name + "_name", count)
+    {
+        count = names.head();
+    }
+    ~Dictionary()
+    {
+        names.head() = count;
+    }
+
+    // -1 for a string never inserted
+    int find(const Mystring<size>& s)
+    {
+        auto found = ids.readonly(s);
+        if (found == nullptr) return -1;
+        return *found;
+    }
+
+    // id of s, which is given a new id if necessary
+    int insert(const Mystring<size>& s)
+    {
+        auto found = ids.readonly(s);
+        if (found != nullptr) return *found;
+        int id = count++;
+        ids.insert(s, id);
+        if (id % NAMES == 0)
+        {
+            Block tmp;
+            names.write(names.new_space(), tmp);
+        }
+        names.readwrite(address(id))->name[id % NAMES] = s;
+        return id;
+    }
+
+    Mystring<size> name(int id)
+    {
+        return names.readonly(address(id))->name[id % NAMES];
+    }
+
+    // ids are 0 ~ id_count()-1
+    int id_count() const
+    {
+        return count;
+    }
+
+    void clean()
+    {
+        ids.clean();
+        names.clean();
+        count = 0;
+    }
+
+private:
+    constexpr static int NAMES = 4000 / size;
+    struct Block
+    {
+        Mystring<size> name[NAMES];
+    };
+    int count = 0;
+    BPT<Mystring<size>, int, Bloom_Filter> ids;
+    Myfile<Block, int> names; // blocks are never freed, so the k-th block is at BASE + k * STRIDE
+
+    inline long address(int id) const
+    {
+        return names.BASE + (long)(id / NAMES) * names.STRIDE;
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,81 @@
+// order-preserving fixed-width encoding of keys for memcmp comparison
+#ifndef KEYCODE_HPP
+#define KEYCODE_HPP
+
+#include <cstring>
+#include "Mystring.hpp"
+
+namespace sjtu
+{
+
+template<int size>
+struct Keycode
+{
+    unsigned char byte[size];
+};
+
+template<int size>
+inline bool operator<(const Keycode<size>& a, const Keycode<size>& b)
+{
+    return memcmp(a.byte, b.byte, size) < 0;
+}
+
+template<int size>
+inline bool operator==(const Keycode<size>& a, const Keycode<size>& b)
+{
+    return memcmp(a.byte, b.byte, size) == 0;
+}
+
+// FNV-1a, for the Bloom filter
+template<int size>
+inline unsigned long long hash(const Keycode<size>& c)
+{
+    unsigned long long res = 14695981039346656037ULL;
+    for (int i = 0; i < size; i++)
+    {
+        res ^= c.byte[i];
+        res *= 1099511628211ULL;
+    }
+    return res;
+}
+
+// a key type without its own encoding is stored as it is
+template<typename K>
+struct Key_Code
+{
+    typedef K code;
+    static const K& encode(const K& key)
+    {
+        return key;
+    }
+};
+
+// bytes before '\0' then zero padding, same order as strcmp
+template<int size>
+struct Key_Code<Mystring<size>>
+{
+    typedef Keycode<size> code;
+    static code encode(const Mystring<size>& key)
+    {
+        code res;
+        int i = 0;
+        for (; i < size && key.string[i]; i++)
+            res.byte[i] = key.string[i];
+        memset(res.byte + i, 0, size - i);
+        return res;
+    }
+};
+
+// write an unsigned value big-endian so that memcmp order equals numeric order
+inline void encode_uint(unsigned char* dest, unsigned long long x, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        dest[i] = x & 255;
+        x >>= 8;
+    }
+}
+
+} // namespace sjtu
+
+#endif
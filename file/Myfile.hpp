@@ -3,50 +3,79 @@
 #ifndef MYFILE_HPP
 #define MYFILE_HPP
 
-#include <fstream>
 #include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
 #include "../STLite/allocator.hpp"
+#include "Uring.hpp"
 
 #define MAX_CACHE 300
 #define HASH_SIZE 631
+#define MAX_BATCH 32 // pages read together by prefetch
+
+// define DIRECT_IO to open files with O_DIRECT, so that pages are
+// cached only by Myfile and not again by the kernel
+#ifdef DIRECT_IO
+#define IO_ALIGN 4096
+#else
+#define IO_ALIGN 1
+#endif
 
 namespace sjtu
 {
 
+// round a size up to IO_ALIGN
+constexpr long frame_size(long size)
+{
+    return (size + IO_ALIGN - 1) / IO_ALIGN * IO_ALIGN;
+}
+
+// slot of a cached T, padded and aligned to IO_ALIGN for direct I/O
+template<typename T>
+struct alignas(IO_ALIGN > alignof(T) ? IO_ALIGN : alignof(T)) Frame
+{
+    union
+    {
+        T data;
+        char page[frame_size(sizeof(T))];
+    };
+    Frame() {}
+};
+
 template<typename T, typename Header>
 class Basefile
 {
 public:
+    constexpr static long HEAD = 2*sizeof(long) + sizeof(Header);
+    constexpr static long BASE = frame_size(HEAD); // address of the first slot
+    constexpr static long STRIDE = sizeof(Frame<T>); // distance between slots
+
     Basefile(const std::string& _name, const Header& _header)
     {
         name = _name;
         header = _header;
-        data.open(name+".db");
-        if (data.good())
+        data_cursor = BASE;
+        buffer = reinterpret_cast<char*>(aligned_alloc(BUFFER_ALIGN, BUFFER_SIZE));
+        fd = open_file(O_RDWR | O_CREAT);
+        if (lseek(fd, 0, SEEK_END) >= HEAD)
         {
-            data.seekg(0);
-            data.read(reinterpret_cast <char *> (&data_cursor), sizeof(long));
-            data.read(reinterpret_cast <char *> (&pool_cursor), sizeof(long));
-            data.read(reinterpret_cast <char *> (&header), sizeof(Header));
+            read_at(buffer, BASE, 0);
+            memcpy(&data_cursor, buffer, sizeof(long));
+            memcpy(&pool_cursor, buffer + sizeof(long), sizeof(long));
+            memcpy(&header, buffer + 2*sizeof(long), sizeof(Header));
         }
         else
-        {
-            data.open(name+".db", std::ios::out);
-            data.close();
-            data.open(name+".db");
-            data.write(reinterpret_cast <char *> (&data_cursor), sizeof(long));
-            data.write(reinterpret_cast <char *> (&pool_cursor), sizeof(long));
-            data.write(reinterpret_cast <char *> (&header), sizeof(Header));
-        }
+            write_head();
     }
 
     ~Basefile()
     {
-        data.seekp(0);
-        data.write(reinterpret_cast <char *> (&data_cursor), sizeof(long));
-        data.write(reinterpret_cast <char *> (&pool_cursor), sizeof(long));
-        data.write(reinterpret_cast <char *> (&header), sizeof(Header));
-        data.close();
+        write_head();
+        close(fd);
+        free(buffer);
     }
 
     long new_space()
@@ -55,37 +84,48 @@ public:
         if (!pool_cursor)
         {
             address = data_cursor;
-            data_cursor += sizeof(T);
+            data_cursor += STRIDE;
             return address;
         }
         address = pool_cursor;
-        data.seekg(pool_cursor);
-        data.read(reinterpret_cast <char *> (&pool_cursor), sizeof(long));
+        read_at(buffer, frame_size(sizeof(long)), pool_cursor);
+        memcpy(&pool_cursor, buffer, sizeof(long));
         return address;
     }
 
     void delete_space(long address)
     {
-        if (address == data_cursor - sizeof(T))
+        if (address == data_cursor - STRIDE)
         {
             data_cursor = address;
             return;
         }
         std::swap(pool_cursor, address);
-        data.seekp(pool_cursor);
-        data.write(reinterpret_cast <char *> (&address), sizeof(long));
+        memset(buffer, 0, frame_size(sizeof(long)));
+        memcpy(buffer, &address, sizeof(long));
+        write_at(buffer, frame_size(sizeof(long)), pool_cursor);
+    }
+
+    inline void read(long address, Frame<T>& frame)
+    {
+        read_at(frame.page, STRIDE, address);
     }
 
-    inline void read(long address, T& value)
+    inline void write(long address, const Frame<T>& frame)
     {
-        data.seekg(address);
-        data.read(reinterpret_cast <char *> (&value), sizeof(T));
+        write_at(frame.page, STRIDE, address);
     }
 
-    inline void write(long address, const T& value)
+    // read n slots with one submission
+    void read(const long* addresses, Frame<T>* const* frames, int n)
     {
-        data.seekp(address);
-        data.write(reinterpret_cast <const char *> (&value), sizeof(T));
+        char* buffers[MAX_BATCH];
+        for (int i = 0; i < n; i++)
+            buffers[i] = frames[i]->page;
+        if (Uring::instance().read(fd, buffers, addresses, STRIDE, n)) return;
+        fail("read");
+        for (int i = 0; i < n; i++)
+            read_at(buffers[i], STRIDE, addresses[i]);
     }
 
     inline Header& head()
@@ -95,20 +135,72 @@ public:
 
     void clean()
     {
-        data_cursor = 2*sizeof(long) + sizeof(Header);
+        data_cursor = BASE;
         pool_cursor = 0;
-        data.close();
-        data.open(name+".db", std::ios::out);
-        data.close();
-        data.open(name+".db");
+        ftruncate(fd, 0);
+        write_head();
     }
 
 private:
-    std::fstream data;
-    long data_cursor = 2*sizeof(long) + sizeof(Header);
+    constexpr static long BUFFER_ALIGN = IO_ALIGN > 64 ? IO_ALIGN : 64;
+    constexpr static long BUFFER_SIZE = (BASE + BUFFER_ALIGN - 1) / BUFFER_ALIGN * BUFFER_ALIGN;
+    int fd;
+    char* buffer; // aligned buffer for the head and pool pointers
+    long data_cursor;
     long pool_cursor = 0;
     Header header;
     std::string name; 
+    bool direct = true; // opened with O_DIRECT, or to be tried
+
+    int open_file(int flags)
+    {
+#ifdef DIRECT_IO
+        if (direct)
+        {
+            int res = open((name+".db").c_str(), flags | O_DIRECT, 0644);
+            if (res >= 0) return res;
+        }
+        // the file system may not support O_DIRECT
+#endif
+        direct = false;
+        int res = open((name+".db").c_str(), flags, 0644);
+        if (res < 0) fail("open");
+        return res;
+    }
+
+    inline void read_at(char* dest, long size, long address)
+    {
+        while (!read_all(fd, dest, size, address)) fail("read");
+    }
+
+    inline void write_at(const char* src, long size, long address)
+    {
+        while (!write_all(fd, src, size, address)) fail("write");
+    }
+
+    // a direct transfer the file system refuses is retried through the page cache,
+    // any other error stops the program rather than leave garbage in a frame
+    void fail(const char* what)
+    {
+        if (errno == EINVAL && direct)
+        {
+            direct = false;
+            close(fd);
+            fd = open_file(O_RDWR);
+            return;
+        }
+        std::cerr << name << ".db: " << what << " failed: " << strerror(errno) << '\n';
+        abort();
+    }
+
+    void write_head()
+    {
+        memset(buffer, 0, BASE);
+        memcpy(buffer, &data_cursor, sizeof(long));
+        memcpy(buffer + sizeof(long), &pool_cursor, sizeof(long));
+        memcpy(buffer + 2*sizeof(long), &header, sizeof(Header));
+        write_at(buffer, BASE, 0);
+    }
 };
 
 template<typename T>
@@ -121,9 +213,7 @@ public:
         Cache_Node* next;
         long address;
         bool dirty;
-        T data;
-        Cache_Node(long a, const T& v, bool w, Cache_Node* p = nullptr, Cache_Node* n = nullptr):
-        address(a), data(v), dirty(w), pre(p), next(n) {}
+        Frame<T>* frame; // taken from the aligned buffer pool
         Cache_Node() {}
     };
 
@@ -138,11 +228,12 @@ public:
     
     ~Cache_List() = default;
 
-    Cache_Node* push_front(long address, const T& data, bool write)
+    // the frame of the new node is left for the caller to fill
+    Cache_Node* push_front(long address, bool write)
     {
         Cache_Node* tmp = memory.new_space();
         tmp->address = address;
-        tmp->data = data;
+        tmp->frame = frames.new_space();
         tmp->dirty = write;
         tmp->pre = head;
         tmp->next = head->next;
@@ -158,6 +249,7 @@ public:
         Cache_Node* topop = end->pre;
         end->pre = topop->pre;
         topop->pre->next = end;
+        frames.delete_space(topop->frame);
         memory.delete_space(topop);
         Size--;
     }
@@ -166,6 +258,7 @@ public:
     {
         toerase->pre->next = toerase->next;
         toerase->next->pre = toerase->pre;
+        frames.delete_space(toerase->frame);
         memory.delete_space(toerase);
         Size--;
     }
@@ -204,6 +297,8 @@ public:
     void clean()
     {
         memory.clean();
+        frames.clean();
+        Size = 0;
         head = memory.new_space();
         end = memory.new_space();
         head->pre = end->next = nullptr;
@@ -216,6 +311,7 @@ private:
     Cache_Node* head;
     Cache_Node* end;
     allocator<Cache_Node, MAX_CACHE+5> memory;
+    allocator<Frame<T>, MAX_CACHE+5> frames;
 };
 
 class Hashmap
@@ -288,6 +384,9 @@ template<typename T, typename Header>
 class Myfile
 {
 public:
+    constexpr static long BASE = Basefile<T, Header>::BASE;
+    constexpr static long STRIDE = Basefile<T, Header>::STRIDE;
+
     Myfile(const std::string& name, const Header& _header): file(name, _header) {}
     ~Myfile()
     {
@@ -295,7 +394,7 @@ public:
         while (tmp->next != nullptr)
         {
             if (tmp->dirty)
-                file.write(tmp->address, tmp->data);
+                file.write(tmp->address, *tmp->frame);
             tmp = tmp->next;
         }
     }
@@ -312,14 +411,13 @@ public:
         {
             auto tmp = reinterpret_cast<typename Cache_List<T>::Cache_Node*> (found);
             list.adjust_to_front(tmp);
-            return &(tmp->data);
+            return &(tmp->frame->data);
         }
-        T value;
-        file.read(address, value);
-        auto ptr = list.push_front(address, value, false);
+        auto ptr = list.push_front(address, false);
+        file.read(address, *ptr->frame);
         node_map.insert(address, reinterpret_cast<long>(ptr));
         if (list.size() > MAX_CACHE) oversize();
-        return &(ptr->data);
+        return &(ptr->frame->data);
     }
 
     T* readwrite(long address)
@@ -330,22 +428,41 @@ public:
             auto tmp = reinterpret_cast<typename Cache_List<T>::Cache_Node*> (found);
             list.adjust_to_front(tmp);
             tmp->dirty = true;
-            return &(tmp->data);
+            return &(tmp->frame->data);
         }
-        T value;
-        file.read(address, value);
-        auto ptr = list.push_front(address, value, true);
+        auto ptr = list.push_front(address, true);
+        file.read(address, *ptr->frame);
         node_map.insert(address, reinterpret_cast<long>(ptr));
         if (list.size() > MAX_CACHE) oversize();
-        return &(ptr->data);
+        return &(ptr->frame->data);
     }
 
     void write(long address, const T& value)
     {
-        node_map.insert(address, reinterpret_cast<long> (list.push_front(address, value, true)));
+        auto ptr = list.push_front(address, true);
+        ptr->frame->data = value;
+        node_map.insert(address, reinterpret_cast<long>(ptr));
         if (list.size() > MAX_CACHE) oversize();
     }
 
+    // load the pages not cached yet in one batch, at most MAX_BATCH of them
+    void prefetch(const long* addresses, int n)
+    {
+        long toread[MAX_BATCH];
+        Frame<T>* frames[MAX_BATCH];
+        int size = 0;
+        for (int i = 0; i < n && size < MAX_BATCH; i++)
+        {
+            if (node_map.find(addresses[i]) != -1) continue;
+            auto ptr = list.push_front(addresses[i], false);
+            node_map.insert(addresses[i], reinterpret_cast<long>(ptr));
+            if (list.size() > MAX_CACHE) oversize();
+            toread[size] = addresses[i];
+            frames[size++] = ptr->frame;
+        }
+        if (size) file.read(toread, frames, size);
+    }
+
     long new_space()
     {
         return file.new_space();
@@ -379,7 +496,7 @@ private:
     {
         auto tmp = list.back();
         if (tmp->dirty)
-            file.write(tmp->address, tmp->data);
+            file.write(tmp->address, *tmp->frame);
         node_map.erase(tmp->address);
         list.pop_back();
     }
@@ -21,19 +21,19 @@ struct Mystring
     {
         strcpy(string, s);
     }
-    void operator=(Mystring other)
+    void operator=(const Mystring& other)
     {
         strcpy(string, other.string);
     }
-    friend bool operator<(Mystring a, Mystring b)
+    friend bool operator<(const Mystring& a, const Mystring& b)
     {
         return strcmp(a.string, b.string) < 0;
     }
-    friend bool operator==(Mystring a, Mystring b)
+    friend bool operator==(const Mystring& a, const Mystring& b)
     {
         return strcmp(a.string, b.string) == 0;
     }
-    friend std::ostream& operator<<(std::ostream& out, Mystring s)
+    friend std::ostream& operator<<(std::ostream& out, const Mystring& s)
     {
         out << s.string;
         return out;
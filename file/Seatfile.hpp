@@ -0,0 +1,96 @@
+// a file of int extents addressed by offset, for seat inventory
+#ifndef SEATFILE_HPP
+#define SEATFILE_HPP
+
+#include "Myfile.hpp"
+
+namespace sjtu
+{
+
+// an extent is never freed and starts zero-filled;
+// its pages are made on the first write, and read as zeros before that
+class Seatfile
+{
+public:
+    Seatfile(const std::string& name): file(name, head)
+    {
+        head = file.head();
+    }
+    ~Seatfile()
+    {
+        file.head() = head;
+    }
+
+    // position of a new extent of size ints
+    long new_space(long size)
+    {
+        long pos = head.top;
+        head.top += size;
+        return pos;
+    }
+
+    void read(long pos, int* dest, int n)
+    {
+        while (n > 0)
+        {
+            int offset = pos % PAGE, len = std::min(n, PAGE - offset);
+            if (pos / PAGE < head.pages)
+                memcpy(dest, file.readonly(address(pos))->s + offset, len * sizeof(int));
+            else
+                memset(dest, 0, len * sizeof(int));
+            pos += len;
+            dest += len;
+            n -= len;
+        }
+    }
+
+    void write(long pos, const int* src, int n)
+    {
+        while (n > 0)
+        {
+            int offset = pos % PAGE, len = std::min(n, PAGE - offset);
+            make_page(pos / PAGE);
+            memcpy(file.readwrite(address(pos))->s + offset, src, len * sizeof(int));
+            pos += len;
+            src += len;
+            n -= len;
+        }
+    }
+
+    void clean()
+    {
+        file.clean();
+        head = Head();
+    }
+
+private:
+    constexpr static int PAGE = 1000;
+    struct Page
+    {
+        int s[PAGE];
+    };
+    struct Head
+    {
+        long top = 0; // ints handed out
+        long pages = 0; // made in file
+    };
+    Head head;
+    Myfile<Page, Head> file;
+
+    // pages are handed out in order, so the k-th page is at BASE + k * STRIDE;
+    // the ones skipped are holes of the file, which read as zeros
+    void make_page(long page)
+    {
+        for (; head.pages <= page; head.pages++)
+            file.new_space();
+    }
+
+    inline long address(long pos) const
+    {
+        return file.BASE + pos / PAGE * file.STRIDE;
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,202 @@
+// a minimal io_uring wrapper to read many pages at once
+#ifndef URING_HPP
+#define URING_HPP
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+#define URING_DEPTH 64
+
+namespace sjtu
+{
+
+// pread all size bytes, zeros past the end of the file; false on an error with errno set
+inline bool read_all(int file, char* buffer, long size, long offset)
+{
+    while (size > 0)
+    {
+        long res = pread(file, buffer, size, offset);
+        if (res < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (res == 0)
+        {
+            memset(buffer, 0, size);
+            return true;
+        }
+        buffer += res;
+        offset += res;
+        size -= res;
+    }
+    return true;
+}
+
+// pwrite all size bytes; false on an error with errno set
+inline bool write_all(int file, const char* buffer, long size, long offset)
+{
+    while (size > 0)
+    {
+        long res = pwrite(file, buffer, size, offset);
+        if (res < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buffer += res;
+        offset += res;
+        size -= res;
+    }
+    return true;
+}
+
+// falls back to pread when io_uring is not available
+class Uring
+{
+public:
+    Uring()
+    {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = syscall(__NR_io_uring_setup, URING_DEPTH, &params);
+        if (fd < 0) return;
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sq_size = cq_size = (sq_size > cq_size ? sq_size : cq_size);
+        sq_ring = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            cq_ring = sq_ring;
+        else
+            cq_ring = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqes = reinterpret_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+        {
+            close(fd);
+            fd = -1;
+            return;
+        }
+        sqe_num = params.sq_entries;
+        char* sq = reinterpret_cast<char*>(sq_ring);
+        char* cq = reinterpret_cast<char*>(cq_ring);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+#endif
+    }
+
+    ~Uring()
+    {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        if (fd < 0) return;
+        munmap(sqes, sqe_num * sizeof(io_uring_sqe));
+        if (cq_ring != sq_ring)
+            munmap(cq_ring, cq_size);
+        munmap(sq_ring, sq_size);
+        close(fd);
+#endif
+    }
+
+    // read size bytes at offset of file into each buffer, all submitted together;
+    // false if some read failed
+    bool read(int file, char* const* buffers, const long* offsets, int size, int n)
+    {
+        bool ok = true;
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        while (fd >= 0 && n > 0)
+        {
+            int batch = n < (int)sqe_num ? n : sqe_num;
+            unsigned tail = *sq_tail;
+            for (int i = 0; i < batch; i++, tail++)
+            {
+                unsigned index = tail & *sq_mask;
+                io_uring_sqe* sqe = sqes + index;
+                memset(sqe, 0, sizeof(io_uring_sqe));
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = file;
+                sqe->addr = reinterpret_cast<unsigned long>(buffers[i]);
+                sqe->len = size;
+                sqe->off = offsets[i];
+                sqe->user_data = i;
+                sq_array[index] = index;
+            }
+            __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+            int submitted = syscall(__NR_io_uring_enter, fd, batch, batch, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted < 0)
+            {
+                // the ring is unusable, read the rest by pread
+                close(fd);
+                fd = -1;
+                break;
+            }
+            // reap, finishing short reads synchronously
+            for (int i = 0; i < batch; )
+            {
+                unsigned head = *cq_head;
+                if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+                {
+                    int res = syscall(__NR_io_uring_enter, fd, batch - submitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                    if (res > 0) submitted += res;
+                    continue;
+                }
+                io_uring_cqe* cqe = cqes + (head & *cq_mask);
+                int id = cqe->user_data, res = cqe->res;
+                __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+                if (res < 0) res = 0;
+                if (res < size && !read_all(file, buffers[id] + res, size - res, offsets[id] + res))
+                    ok = false;
+                i++;
+            }
+            buffers += batch;
+            offsets += batch;
+            n -= batch;
+        }
+#endif
+        for (int i = 0; i < n; i++)
+            if (!read_all(file, buffers[i], size, offsets[i]))
+                ok = false;
+        return ok;
+    }
+
+    // one ring shared by all files
+    static Uring& instance()
+    {
+        static Uring ring;
+        return ring;
+    }
+
+private:
+    int fd = -1;
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    unsigned sqe_num = 0;
+    size_t sq_size = 0;
+    size_t cq_size = 0;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+#endif
+};
+
+} // namespace sjtu
+
+#endif
@@ -58,8 +58,9 @@ public:
         else if (tokens[1] == "query_ticket")
         {
             Mystring<31> s, t;
-            Date d;
-            bool p = 0;
+            Date d, e;
+            bool p = 0, range = 0;
+            int k = -1;
             for (int i = 2; i < tokens.size(); i += 2)
             {
                 if (tokens[i] == "-s")
@@ -68,10 +69,17 @@ public:
                     t = tokens[i+1];
                 else if (tokens[i] == "-d")
                     d = tokens[i+1];
+                else if (tokens[i] == "-e")
+                {
+                    e = tokens[i+1];
+                    range = 1;
+                }
+                else if (tokens[i] == "-k")
+                    k = std::stoi(tokens[i+1]);
                 else if (tokens[i+1] == "cost")
                     p = 1;
             }
-            train_system.query_ticket(s, t, d, p);
+            train_system.query_ticket(s, t, d, range ? e : d, p, k);
         }
         else if (tokens[1] == "buy_ticket")
         {
@@ -103,7 +111,12 @@ public:
                 std::cout << "-1\n";
                 return;
             }
-            train_system.buy_ticket(u, id, d, f, t, n, q);
+            long head;
+            int count;
+            user_system.order_log(u, head, count);
+            long order = train_system.buy_ticket(head, id, d, f, t, n, q);
+            if (order != -1)
+                user_system.add_order(u, order);
         }
         else if (tokens[1] == "login")
         {
@@ -171,7 +184,10 @@ public:
                 std::cout << "-1\n";
                 return;
             }
-            train_system.query_order(tokens[3]);
+            long head;
+            int count;
+            user_system.order_log(tokens[3], head, count);
+            train_system.query_order(head, count);
         }
         else if (tokens[1] == "add_user")
         {
@@ -241,21 +257,18 @@ public:
             data.start_date = d[0];
             data.end_date = d[1];
             data.type = y;
-            strcpy(data.stations[0], s[0].c_str());
             data.seat = m;
             data.leave_time[0] = x;
             data.price[0] = 0;
             for (char i = 1; i < n-1; i++)
             {
-                strcpy(data.stations[i], s[i].c_str());
                 data.arrive_time[i-1] = data.leave_time[i-1] + std::stoi(t[i-1]);
                 data.leave_time[i] = data.arrive_time[i-1] + std::stoi(o[i-1]);
                 data.price[i] = data.price[i-1] + std::stoi(p[i-1]);
             }
-            strcpy(data.stations[n-1], s[n-1].c_str());
             data.arrive_time[n-2] = data.leave_time[n-2] + std::stoi(t[n-2]);
             data.price[n-1] = data.price[n-2] + std::stoi(p[n-2]);
-            train_system.add_train(id, data);
+            train_system.add_train(id, data, s);
         }
         else if (tokens[1] == "delete_train")
         {
@@ -296,6 +309,21 @@ public:
             }
             train_system.query_transfer(s, t, d, p);
         }
+        else if (tokens[1] == "query_route")
+        {
+            Mystring<31> s, t;
+            Date d;
+            for (int i = 2; i < tokens.size(); i += 2)
+            {
+                if (tokens[i] == "-s")
+                    s = tokens[i+1];
+                else if (tokens[i] == "-t")
+                    t = tokens[i+1];
+                else if (tokens[i] == "-d")
+                    d = tokens[i+1];
+            }
+            train_system.query_route(s, t, d);
+        }
         else if (tokens[1] == "refund_ticket")
         {
             Mystring<21> u;
@@ -308,10 +336,20 @@ public:
                     n = std::stoi(tokens[i+1]);
             }
             if (user_system.check_login(u.string))
-                std::cout << train_system.refund_ticket(u, n-1) << '\n';
+            {
+                long head;
+                int count;
+                user_system.order_log(u.string, head, count);
+                std::cout << train_system.refund_ticket(head, count, n-1) << '\n';
+            }
             else
                 std::cout << "-1\n";
         }
+        else if (tokens[1] == "query_cache")
+        {
+            const Query_Cache& cache = train_system.query_cache();
+            std::cout << cache.hits() << ' ' << cache.misses() << ' ' << train_system.station_fill() << '\n';
+        }
         else if (tokens[1] == "clean")
         {
             train_system.clean();
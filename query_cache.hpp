@@ -0,0 +1,279 @@
+// an LRU cache of query output, checked against version counters
+#ifndef QUERY_CACHE_HPP
+#define QUERY_CACHE_HPP
+
+#include <string>
+#include "STLite/vector.hpp"
+#include "STLite/utility.hpp"
+#include "date.hpp"
+
+#define QUERY_CACHE 1024 // entries kept
+#define QUERY_HASH 2053
+
+namespace sjtu
+{
+
+// versions of train-days, 0 for a train-day never touched
+class Version_Table
+{
+public:
+    Version_Table(): key(new long long[16]), value(new int[16]), cap(16)
+    {
+        for (int i = 0; i < cap; i++) key[i] = -1;
+    }
+    ~Version_Table()
+    {
+        delete []key;
+        delete []value;
+    }
+
+    int find(long long k) const
+    {
+        for (int i = slot(k); key[i] != -1; i = (i + 1) & (cap - 1))
+            if (key[i] == k) return value[i];
+        return 0;
+    }
+
+    void touch(long long k)
+    {
+        int i = slot(k);
+        for (; key[i] != -1; i = (i + 1) & (cap - 1))
+            if (key[i] == k)
+            {
+                value[i]++;
+                return;
+            }
+        key[i] = k;
+        value[i] = 1;
+        if (++size * 2 > cap) grow();
+    }
+
+    void clean()
+    {
+        for (int i = 0; i < cap; i++) key[i] = -1;
+        size = 0;
+    }
+
+private:
+    long long* key;
+    int* value;
+    int cap; // a power of 2
+    int size = 0;
+
+    inline int slot(long long k) const
+    {
+        unsigned long long x = k * 0x9e3779b97f4a7c15ULL;
+        return (x >> 32) & (cap - 1);
+    }
+
+    void grow()
+    {
+        long long* old_key = key;
+        int* old_value = value;
+        int old_cap = cap;
+        cap <<= 1;
+        key = new long long[cap];
+        value = new int[cap];
+        for (int i = 0; i < cap; i++) key[i] = -1;
+        for (int i = 0; i < old_cap; i++)
+        {
+            if (old_key[i] == -1) continue;
+            int j = slot(old_key[i]);
+            while (key[j] != -1) j = (j + 1) & (cap - 1);
+            key[j] = old_key[i];
+            value[j] = old_value[i];
+        }
+        delete []old_key;
+        delete []old_value;
+    }
+};
+
+// an entry is valid while its two stations have no new train released
+// and none of the train-days it prints has its seats changed
+class Query_Cache
+{
+public:
+    struct Query
+    {
+        char kind; // 0 for query_ticket, 1 for query_transfer
+        bool p;
+        Date d;
+        int a; // station ids
+        int b;
+        int k;
+        friend bool operator==(const Query& x, const Query& y)
+        {
+            return x.kind == y.kind && x.p == y.p && x.d == y.d && x.a == y.a && x.b == y.b && x.k == y.k;
+        }
+    };
+
+    Query_Cache()
+    {
+        for (int i = 0; i < QUERY_HASH; i++) bucket[i] = -1;
+        for (int i = 0; i < QUERY_CACHE; i++) free_entry[i] = QUERY_CACHE - 1 - i;
+    }
+
+    // the output of q if cached and still valid
+    const std::string* find(const Query& q)
+    {
+        int h = hash(q);
+        for (int i = bucket[h]; i != -1; i = entry[i].chain)
+        {
+            if (!(entry[i].q == q)) continue;
+            if (!valid(entry[i]))
+            {
+                erase(i);
+                break;
+            }
+            hit++;
+            to_front(i);
+            return &entry[i].out;
+        }
+        miss++;
+        return nullptr;
+    }
+
+    // seats lists the train-days printed, as seat_key
+    void insert(const Query& q, const char* out, int len, const vector<long long>& seats)
+    {
+        if (!free_num) erase(tail);
+        int i = free_entry[--free_num];
+        Entry& e = entry[i];
+        e.q = q;
+        e.out.assign(out, len);
+        e.a_version = station_version(q.a);
+        e.b_version = station_version(q.b);
+        e.seats.clear();
+        for (int j = 0; j < (int)seats.size(); j++)
+            e.seats.push_back(pair<long long, int>(seats[j], seat_version.find(seats[j])));
+        int h = hash(q);
+        e.chain = bucket[h];
+        bucket[h] = i;
+        e.pre = -1;
+        e.next = head;
+        if (head != -1) entry[head].pre = i;
+        head = i;
+        if (tail == -1) tail = i;
+    }
+
+    // a train is released through station x
+    void touch_station(int x)
+    {
+        while ((int)station.size() <= x) station.push_back(0);
+        station[x]++;
+    }
+
+    // the seats of a train-day are changed
+    void touch_seat(long long x)
+    {
+        seat_version.touch(x);
+    }
+
+    static inline long long seat_key(int train, Date d)
+    {
+        return (long long)train << 16 | d.n;
+    }
+
+    long long hits() const
+    {
+        return hit;
+    }
+
+    long long misses() const
+    {
+        return miss;
+    }
+
+    void clean()
+    {
+        for (int i = 0; i < QUERY_HASH; i++) bucket[i] = -1;
+        for (int i = 0; i < QUERY_CACHE; i++) free_entry[i] = QUERY_CACHE - 1 - i;
+        free_num = QUERY_CACHE;
+        head = tail = -1;
+        station.clear();
+        seat_version.clean();
+        hit = miss = 0;
+    }
+
+private:
+    struct Entry
+    {
+        Query q;
+        std::string out;
+        int a_version;
+        int b_version;
+        vector<pair<long long, int>> seats;
+        int chain; // next entry in the bucket
+        int pre; // LRU list, most recent first
+        int next;
+    };
+    Entry entry[QUERY_CACHE];
+    int free_entry[QUERY_CACHE];
+    int free_num = QUERY_CACHE;
+    int bucket[QUERY_HASH];
+    int head = -1;
+    int tail = -1;
+    vector<int> station; // versions by station id
+    Version_Table seat_version;
+    long long hit = 0;
+    long long miss = 0;
+
+    static int hash(const Query& q)
+    {
+        unsigned long long res = q.kind * 2 + q.p;
+        res = res * 1000003 + q.a;
+        res = res * 1000003 + q.b;
+        res = res * 1000003 + q.d.n;
+        res = res * 1000003 + (unsigned)q.k;
+        return res % QUERY_HASH;
+    }
+
+    inline int station_version(int x) const
+    {
+        return x < (int)station.size() ? station[x] : 0;
+    }
+
+    bool valid(const Entry& e) const
+    {
+        if (e.a_version != station_version(e.q.a) || e.b_version != station_version(e.q.b))
+            return false;
+        for (int i = 0; i < (int)e.seats.size(); i++)
+            if (seat_version.find(e.seats[i].first) != e.seats[i].second)
+                return false;
+        return true;
+    }
+
+    void to_front(int i)
+    {
+        if (i == head) return;
+        entry[entry[i].pre].next = entry[i].next;
+        if (entry[i].next != -1) entry[entry[i].next].pre = entry[i].pre;
+        else tail = entry[i].pre;
+        entry[i].pre = -1;
+        entry[i].next = head;
+        entry[head].pre = i;
+        head = i;
+    }
+
+    void erase(int i)
+    {
+        int h = hash(entry[i].q);
+        if (bucket[h] == i)
+            bucket[h] = entry[i].chain;
+        else
+        {
+            int j = bucket[h];
+            while (entry[j].chain != i) j = entry[j].chain;
+            entry[j].chain = entry[i].chain;
+        }
+        if (entry[i].pre != -1) entry[entry[i].pre].next = entry[i].next;
+        else head = entry[i].next;
+        if (entry[i].next != -1) entry[entry[i].next].pre = entry[i].pre;
+        else tail = entry[i].pre;
+        free_entry[free_num++] = i;
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,262 @@
+// a connection scan over a few days of the timetable, for journeys of several legs
+#ifndef ROUTE_HPP
+#define ROUTE_HPP
+
+#include "STLite/vector.hpp"
+#include "STLite/algorithm.hpp"
+
+#define MAX_LEGS 3
+// days of departures scanned from the query date: every leg of a journey
+// leaves within ROUTE_DAYS days, so longer itineraries are not found
+#define ROUTE_DAYS 3
+
+namespace sjtu
+{
+
+// a train-day running from one station to the next, times in minutes from the query date
+struct Connection
+{
+    int leave;
+    int arrive;
+    int from; // station ids
+    int to;
+    int trip; // train-day
+    int price;
+    char num; // from is the num-th station of the train
+};
+
+// labels are Pareto-optimal on (arrive, price, legs) at each station, so that
+// the journeys to b are Pareto-optimal on (arrive, price) within MAX_LEGS legs
+class Route_Engine
+{
+public:
+    struct Leg
+    {
+        int board; // connections
+        int alight;
+    };
+    struct Journey
+    {
+        int leave;
+        int arrive;
+        int price;
+        int legs;
+        Leg leg[MAX_LEGS];
+    };
+
+    void clear()
+    {
+        conn.clear();
+        trips = stations = 0;
+    }
+
+    // connections are added in the order of leave
+    void add(const Connection& c)
+    {
+        conn.push_back(c);
+        if (c.trip >= trips) trips = c.trip + 1;
+        if (c.from >= stations) stations = c.from + 1;
+        if (c.to >= stations) stations = c.to + 1;
+    }
+
+    const Connection& connection(int i) const
+    {
+        return conn[i];
+    }
+
+    // journeys from a to b leaving a before first_end, in the order of arrival then price;
+    // seat_ok(trip, num) tells whether the trip has a seat left from its num-th station to the next
+    template<typename Seat_Check>
+    void search(int a, int b, int first_end, Seat_Check seat_ok, vector<Journey>& res)
+    {
+        if (a >= stations || b >= stations || a == b) return;
+        new_search();
+        int size = conn.size();
+        for (int i = 0; i < size; i++)
+        {
+            const Connection& c = conn[i];
+            Trip& trip = trip_state[c.trip];
+            if (trip.stamp != stamp)
+            {
+                trip.stamp = stamp;
+                for (int l = 0; l < MAX_LEGS; l++) trip.best[l].label = -2;
+            }
+            bool from_a = c.from == a && c.leave < first_end;
+            if (!from_a && bag_stamp[c.from] != stamp && !trip.riding()) continue;
+            if (!seat_ok(c.trip, c.num))
+            {
+                for (int l = 0; l < MAX_LEGS; l++) trip.best[l].label = -2;
+                continue;
+            }
+            // board from a, or from the labels that arrived in time
+            if (from_a) trip.board(0, 0, -1, i);
+            if (bag_stamp[c.from] == stamp)
+                for (int k = bag_head[c.from]; k != -1; k = label[k].next)
+                {
+                    const Label& x = label[k];
+                    if (x.dead || x.arrive > c.leave || x.legs == MAX_LEGS || x.trip == c.trip) continue;
+                    trip.board(x.legs, x.price, k, i);
+                }
+            // ride to the next station and get off there
+            for (int l = 0; l < MAX_LEGS; l++)
+            {
+                Riding& r = trip.best[l];
+                if (r.label == -2) continue;
+                r.price += c.price;
+                if (c.to != a)
+                    insert(c.to, b, c.arrive, r.price, l + 1, r.label, c.trip, r.board, i);
+            }
+        }
+        collect(b, res);
+    }
+
+private:
+    struct Label
+    {
+        int arrive;
+        int price;
+        char legs;
+        bool dead; // dominated by a later label
+        int prev; // label boarded from, -1 for a
+        int trip;
+        int board;
+        int alight;
+        int next; // in the bag of the station
+    };
+    struct Riding
+    {
+        int price; // paid till now
+        int label; // boarded from, -1 for a, -2 for none
+        int board;
+    };
+    struct Trip
+    {
+        int stamp = 0;
+        Riding best[MAX_LEGS]; // the cheapest by legs taken
+        bool riding() const
+        {
+            for (int l = 0; l < MAX_LEGS; l++)
+                if (best[l].label != -2) return true;
+            return false;
+        }
+        void board(int legs, int price, int label, int c)
+        {
+            Riding& r = best[legs];
+            if (r.label != -2 && r.price <= price) return;
+            r.price = price;
+            r.label = label;
+            r.board = c;
+        }
+    };
+    vector<Connection> conn;
+    int trips = 0;
+    int stations = 0;
+    // the memory below is kept between searches, valid by stamp like the reach table
+    vector<Label> label;
+    int label_num = 0;
+    vector<Trip> trip_state;
+    vector<int> bag_head;
+    vector<int> bag_tail;
+    vector<int> bag_stamp;
+    int stamp = 0;
+
+    void new_search()
+    {
+        stamp++;
+        label_num = 0;
+        while ((int)trip_state.size() < trips) trip_state.push_back(Trip());
+        while ((int)bag_stamp.size() < stations)
+        {
+            bag_stamp.push_back(0);
+            bag_head.push_back(-1);
+            bag_tail.push_back(-1);
+        }
+    }
+
+    static inline bool dominate(const Label& x, int arrive, int price, int legs)
+    {
+        return !x.dead && x.arrive <= arrive && x.price <= price && x.legs <= legs;
+    }
+
+    void insert(int v, int b, int arrive, int price, int legs, int prev, int trip, int board, int alight)
+    {
+        // going on from v to b only adds time, price and legs, so a journey found to b
+        // that is as early, as cheap and as short as this label leaves it of no use
+        if (v != b && bag_stamp[b] == stamp)
+            for (int k = bag_head[b]; k != -1; k = label[k].next)
+                if (dominate(label[k], arrive, price, legs)) return;
+        if (bag_stamp[v] == stamp)
+        {
+            for (int k = bag_head[v]; k != -1; k = label[k].next)
+                if (dominate(label[k], arrive, price, legs)) return;
+            for (int k = bag_head[v]; k != -1; k = label[k].next)
+                if (arrive <= label[k].arrive && price <= label[k].price && legs <= label[k].legs)
+                    label[k].dead = true;
+        }
+        Label tmp;
+        tmp.arrive = arrive;
+        tmp.price = price;
+        tmp.legs = legs;
+        tmp.dead = false;
+        tmp.prev = prev;
+        tmp.trip = trip;
+        tmp.board = board;
+        tmp.alight = alight;
+        tmp.next = -1;
+        int pos = label_num++;
+        if (pos < (int)label.size())
+            label[pos] = tmp;
+        else
+            label.push_back(tmp);
+        if (bag_stamp[v] != stamp)
+        {
+            bag_stamp[v] = stamp;
+            bag_head[v] = pos;
+        }
+        else
+            label[bag_tail[v]].next = pos;
+        bag_tail[v] = pos;
+    }
+
+    // the labels of b that no other is as early and as cheap as, fewer legs first on ties
+    void collect(int b, vector<Journey>& res)
+    {
+        if (bag_stamp[b] != stamp) return;
+        for (int k = bag_head[b]; k != -1; k = label[k].next)
+        {
+            const Label& y = label[k];
+            if (y.dead) continue;
+            bool keep = true;
+            for (int j = bag_head[b]; j != -1 && keep; j = label[j].next)
+            {
+                const Label& x = label[j];
+                if (j == k || x.dead || x.arrive > y.arrive || x.price > y.price) continue;
+                if (x.arrive < y.arrive || x.price < y.price || x.legs < y.legs) keep = false;
+            }
+            if (!keep) continue;
+            Journey journey;
+            journey.arrive = y.arrive;
+            journey.price = y.price;
+            journey.legs = y.legs;
+            int l = y.legs;
+            for (int j = k; j != -1; j = label[j].prev)
+            {
+                l--;
+                journey.leg[l].board = label[j].board;
+                journey.leg[l].alight = label[j].alight;
+            }
+            journey.leave = conn[journey.leg[0].board].leave;
+            res.push_back(journey);
+        }
+        if (!res.empty())
+            sort(&res[0], &res[0] + res.size(), [](const Journey& x, const Journey& y)
+            {
+                if (x.arrive != y.arrive) return x.arrive < y.arrive;
+                return x.price < y.price;
+            });
+    }
+};
+
+} // namespace sjtu
+
+#endif
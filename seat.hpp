@@ -0,0 +1,130 @@
+// a row of sold tickets with range max and range add
+#ifndef SEAT_HPP
+#define SEAT_HPP
+
+#include <iostream>
+#include "seat_kernel.hpp"
+
+#define SEAT_BLOCK 16
+#define SEAT_FLAT 128 // rows of at most this many sections are not cut into blocks
+
+namespace sjtu
+{
+
+// tickets sold on each section of a train on one day, cut into blocks
+// of SEAT_BLOCK sections; a block keeps its max and an add pending for
+// the whole block, so both operations touch O(n / SEAT_BLOCK + SEAT_BLOCK) ints
+// layout: values, then the max of each block, then the add of each block
+// a row of at most SEAT_FLAT sections is just its values, so that a kernel
+// runs over the whole [l, r) instead of the few ints left between blocks
+// a zero-filled row is a row with nothing sold
+template<int maxlen>
+class Seat_Row
+{
+public:
+    Seat_Row(int _len): len(_len), blocks(_len <= SEAT_FLAT ? 0 : (_len + SEAT_BLOCK - 1) / SEAT_BLOCK) {}
+
+    // ints taken by a row of len sections
+    static int size(int len)
+    {
+        if (len <= SEAT_FLAT) return len;
+        return (len + SEAT_BLOCK - 1) / SEAT_BLOCK * (SEAT_BLOCK + 2);
+    }
+
+    int size() const
+    {
+        return blocks ? blocks * (SEAT_BLOCK + 2) : len;
+    }
+
+    // to be filled or stored as a whole
+    int* data()
+    {
+        return row;
+    }
+
+    int operator[](int i) const
+    {
+        if (!blocks) return row[i];
+        return row[i] + add_of(i / SEAT_BLOCK);
+    }
+
+    // max of sections [l, r)
+    int max(int l, int r) const
+    {
+        if (!blocks) return Seat_Kernel::instance().max(row + l + 1, r - l - 1, row[l]);
+        int lb = l / SEAT_BLOCK, rb = (r - 1) / SEAT_BLOCK;
+        if (lb == rb)
+            return block_max(lb, l, r);
+        int res = block_max(lb, l, (lb + 1) * SEAT_BLOCK);
+        res = Seat_Kernel::instance().max(row + blocks * SEAT_BLOCK + lb + 1, rb - lb - 1, res);
+        return std::max(res, block_max(rb, rb * SEAT_BLOCK, r));
+    }
+
+    // add x to sections [l, r)
+    void add(int l, int r, int x)
+    {
+        if (!blocks)
+        {
+            Seat_Kernel::instance().add(row + l, r - l, x);
+            return;
+        }
+        int lb = l / SEAT_BLOCK, rb = (r - 1) / SEAT_BLOCK;
+        if (lb == rb)
+        {
+            block_add(lb, l, r, x);
+            return;
+        }
+        block_add(lb, l, (lb + 1) * SEAT_BLOCK, x);
+        Seat_Kernel::instance().add(&add_of(lb + 1), rb - lb - 1, x);
+        Seat_Kernel::instance().add(&max_of(lb + 1), rb - lb - 1, x);
+        block_add(rb, rb * SEAT_BLOCK, r, x);
+    }
+
+private:
+    constexpr static int MAXSIZE = (maxlen + SEAT_BLOCK - 1) / SEAT_BLOCK * (SEAT_BLOCK + 2);
+    int len;
+    int blocks; // 0 for a flat row
+    int row[MAXSIZE];
+
+    inline int& max_of(int k)
+    {
+        return row[blocks * SEAT_BLOCK + k];
+    }
+    inline int max_of(int k) const
+    {
+        return row[blocks * SEAT_BLOCK + k];
+    }
+    inline int& add_of(int k)
+    {
+        return row[blocks * (SEAT_BLOCK + 1) + k];
+    }
+    inline int add_of(int k) const
+    {
+        return row[blocks * (SEAT_BLOCK + 1) + k];
+    }
+
+    // [l, r) lies in block k
+    int block_max(int k, int l, int r) const
+    {
+        if (r - l == SEAT_BLOCK) return max_of(k);
+        return Seat_Kernel::instance().max(row + l + 1, r - l - 1, row[l]) + add_of(k);
+    }
+
+    void block_add(int k, int l, int r, int x)
+    {
+        if (r - l == SEAT_BLOCK)
+        {
+            add_of(k) += x;
+            max_of(k) += x;
+            return;
+        }
+        auto& kernel = Seat_Kernel::instance();
+        kernel.add(row + l, r - l, x);
+        int begin = k * SEAT_BLOCK, end = std::min(len, begin + SEAT_BLOCK);
+        max_of(k) = kernel.max(row + begin + 1, end - begin - 1, row[begin]) + add_of(k);
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,129 @@
+// range max and range add over int arrays, picked by the cpu at runtime
+#ifndef SEAT_KERNEL_HPP
+#define SEAT_KERNEL_HPP
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEAT_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace sjtu
+{
+
+namespace kernel
+{
+
+inline int max_scalar(const int* a, int n, int res)
+{
+    for (int i = 0; i < n; i++)
+        if (a[i] > res) res = a[i];
+    return res;
+}
+
+inline void add_scalar(int* a, int n, int x)
+{
+    for (int i = 0; i < n; i++)
+        a[i] += x;
+}
+
+#ifdef SEAT_KERNEL_X86
+__attribute__((target("sse4.1")))
+inline int max_sse(const int* a, int n, int res)
+{
+    int i = 0;
+    if (n >= 4)
+    {
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        for (i = 4; i + 4 <= n; i += 4)
+            m = _mm_max_epi32(m, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        m = _mm_max_epi32(m, _mm_shuffle_epi32(m, 0x4e));
+        m = _mm_max_epi32(m, _mm_shuffle_epi32(m, 0xb1));
+        int v = _mm_cvtsi128_si32(m);
+        if (v > res) res = v;
+    }
+    return max_scalar(a + i, n - i, res);
+}
+
+__attribute__((target("sse4.1")))
+inline void add_sse(int* a, int n, int x)
+{
+    __m128i v = _mm_set1_epi32(x);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i* p = reinterpret_cast<__m128i*>(a + i);
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), v));
+    }
+    add_scalar(a + i, n - i, x);
+}
+
+__attribute__((target("avx2")))
+inline int max_avx2(const int* a, int n, int res)
+{
+    int i = 0;
+    if (n >= 8)
+    {
+        __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        for (i = 8; i + 8 <= n; i += 8)
+            m = _mm256_max_epi32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        __m128i h = _mm_max_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+        h = _mm_max_epi32(h, _mm_shuffle_epi32(h, 0x4e));
+        h = _mm_max_epi32(h, _mm_shuffle_epi32(h, 0xb1));
+        int v = _mm_cvtsi128_si32(h);
+        if (v > res) res = v;
+    }
+    return max_scalar(a + i, n - i, res);
+}
+
+__attribute__((target("avx2")))
+inline void add_avx2(int* a, int n, int x)
+{
+    __m256i v = _mm256_set1_epi32(x);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i* p = reinterpret_cast<__m256i*>(a + i);
+        _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), v));
+    }
+    add_scalar(a + i, n - i, x);
+}
+#endif
+
+} // namespace kernel
+
+class Seat_Kernel
+{
+public:
+    // max of res and a[0 ~ n-1]
+    int (*max)(const int* a, int n, int res);
+    // add x to a[0 ~ n-1]
+    void (*add)(int* a, int n, int x);
+
+    Seat_Kernel(): max(kernel::max_scalar), add(kernel::add_scalar)
+    {
+#ifdef SEAT_KERNEL_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            max = kernel::max_avx2;
+            add = kernel::add_avx2;
+        }
+        else if (__builtin_cpu_supports("sse4.1"))
+        {
+            max = kernel::max_sse;
+            add = kernel::add_sse;
+        }
+#endif
+    }
+
+    // the best kernels of this cpu
+    static Seat_Kernel& instance()
+    {
+        static Seat_Kernel res;
+        return res;
+    }
+};
+
+} // namespace sjtu
+
+#endif
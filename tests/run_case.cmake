@@ -0,0 +1,8 @@
+# run code on NAME.in in an empty directory and compare the output with NAME.out
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${WORK})
+execute_process(COMMAND ${CODE} INPUT_FILE ${DIR}/${NAME}.in OUTPUT_FILE ${WORK}/${NAME}.res WORKING_DIRECTORY ${WORK})
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK}/${NAME}.res ${DIR}/${NAME}.out RESULT_VARIABLE diff)
+if (diff)
+    message(FATAL_ERROR "${NAME}: output differs from ${NAME}.out")
+endif()
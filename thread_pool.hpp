@@ -0,0 +1,141 @@
+// a work-stealing thread pool for splitting a loop across cores
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#define MAX_THREADS 8
+
+namespace sjtu
+{
+
+// the calling thread works as worker 0 while run() waits
+class Thread_Pool
+{
+public:
+    Thread_Pool()
+    {
+        int n = std::thread::hardware_concurrency();
+        threads = n < 1 ? 1 : (n > MAX_THREADS ? MAX_THREADS : n);
+        for (int i = 1; i < threads; i++)
+            worker[i] = std::thread(&Thread_Pool::work, this, i);
+    }
+
+    ~Thread_Pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        start.notify_all();
+        for (int i = 1; i < threads; i++)
+            worker[i].join();
+    }
+
+    int size() const
+    {
+        return threads;
+    }
+
+    // call task(t, w) for every t in [0, n), where w is the worker running it
+    void run(int n, const std::function<void(int, int)>& task)
+    {
+        if (n <= 0) return;
+        // each worker starts with an even share, and steals from the back of others when done
+        for (int i = 0; i < threads; i++)
+        {
+            std::lock_guard<std::mutex> guard(queue[i].lock);
+            queue[i].lo = (long)n * i / threads;
+            queue[i].hi = (long)n * (i + 1) / threads;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            job = &task;
+            busy = threads - 1;
+            generation++;
+        }
+        start.notify_all();
+        int t;
+        while (take(0, t))
+            task(t, 0);
+        std::unique_lock<std::mutex> guard(lock);
+        finish.wait(guard, [this] { return busy == 0; });
+        job = nullptr;
+    }
+
+    static Thread_Pool& instance()
+    {
+        static Thread_Pool pool;
+        return pool;
+    }
+
+private:
+    struct alignas(64) Queue
+    {
+        std::mutex lock;
+        int lo = 0; // tasks [lo, hi) not taken yet
+        int hi = 0;
+    };
+    int threads;
+    std::thread worker[MAX_THREADS];
+    Queue queue[MAX_THREADS];
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable finish;
+    const std::function<void(int, int)>* job = nullptr;
+    int busy = 0;
+    int generation = 0;
+    bool stop = false;
+
+    bool take(int w, int& t)
+    {
+        {
+            std::lock_guard<std::mutex> guard(queue[w].lock);
+            if (queue[w].lo < queue[w].hi)
+            {
+                t = queue[w].lo++;
+                return true;
+            }
+        }
+        for (int i = 1; i < threads; i++)
+        {
+            Queue& victim = queue[(w + i) % threads];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.lo < victim.hi)
+            {
+                t = --victim.hi;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(int w)
+    {
+        int seen = 0;
+        while (true)
+        {
+            const std::function<void(int, int)>* task;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                start.wait(guard, [this, seen] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+                task = job;
+            }
+            int t;
+            while (take(w, t))
+                (*task)(t, w);
+            std::lock_guard<std::mutex> guard(lock);
+            if (!--busy)
+                finish.notify_one();
+        }
+    }
+};
+
+} // namespace sjtu
+
+#endif
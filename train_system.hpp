@@ -7,35 +7,112 @@
 #include "STLite/algorithm.hpp"
 #include "STLite/utility.hpp"
 #include "STLite/vector.hpp"
-#include "STLite/map.hpp"
+#include "STLite/intersect.hpp"
 #include "file/Mystring.hpp"
 #include "B_plus_tree/Multi_BPT.hpp"
+#include "file/Dictionary.hpp"
+#include "file/Seatfile.hpp"
 #include "date.hpp"
+#include "seat.hpp"
+#include "buffer.hpp"
+#include "query_cache.hpp"
+#include "thread_pool.hpp"
+#include "route.hpp"
 
 #define MAXSTA 100
+#define TRANSFER_TASK 8 // trains by b searched in one task
+#define PAIR_LIMIT 32 // trains with more stations are searched by joining long_index
+#define ROUTE_CACHE 8 // days of connections kept for query_route
+#define MAX_SALE_DAYS month_start[12] // the longest sale range of a train, a whole year
+#define DAY_BITS 9 // of Order_Data::day, enough for a day of the sale range
 
 namespace sjtu
 {
 
+// the part of a train read by searches
 struct Train_Data
 {
     Date start_date;
     Date end_date;
-    Time leave_time[MAXSTA-1]; // no leave_time for last station
-    Time arrive_time[MAXSTA-1]; // no arrive_time for first station
-    char stations[MAXSTA][31];
     bool released;
     char station_num;
     char type;
     int seat; // no seat for last station
+    long stations; // address of the Train_Stations in station_db
+    long seats; // extent in seat_file after release, a Seat_Row per day
+    int serial; // id in train_dict after release
+    // minutes from the midnight of the departure date, so the day of each is a division away
+    Time leave_time[MAXSTA-1]; // no leave_time for last station
+    Time arrive_time[MAXSTA-1]; // no arrive_time for first station
     int price[MAXSTA]; // the price from first station
 };
 
+// the part of a train read only to print or match station names
+struct Train_Stations
+{
+    int id[MAXSTA]; // ids in station_dict
+};
+
+struct Seat_Index
+{
+    Date date;
+    Mystring<21> id;
+    friend bool operator<(const Seat_Index& a, const Seat_Index& b)
+    {
+        int res = strcmp(a.id.string, b.id.string);
+        if (res) return res < 0;
+        return a.date < b.date;
+    }
+    friend bool operator==(const Seat_Index& a, const Seat_Index& b)
+    {
+        return a.id == b.id && a.date == b.date;
+    }
+};
+
+// train id first, then date
+template<>
+struct Key_Code<Seat_Index>
+{
+    typedef Keycode<23> code;
+    static code encode(const Seat_Index& x)
+    {
+        code res;
+        auto id = Key_Code<Mystring<21>>::encode(x.id);
+        auto date = Key_Code<Date>::encode(x.date);
+        memcpy(res.byte, id.byte, 21);
+        memcpy(res.byte + 21, date.byte, 2);
+        return res;
+    }
+};
+
+// a train-day and a boarding station, the key of the waitlist
+struct Queue_Key
+{
+    Seat_Index index;
+    char f_id;
+    Queue_Key(const Seat_Index& i, int f): index(i), f_id(f) {}
+};
+
+template<>
+struct Key_Code<Queue_Key>
+{
+    typedef Keycode<24> code;
+    static code encode(const Queue_Key& x)
+    {
+        code res;
+        auto index = Key_Code<Seat_Index>::encode(x.index);
+        memcpy(res.byte, index.byte, 23);
+        res.byte[23] = x.f_id;
+        return res;
+    }
+};
+
 class Train_System
 {
 public:
-    Train_System(): train_db("train"), train_index("station_index"), seat_db("seat"),
-    order_db("order"), order_index("user_order_index"), order_queue("order_queue") {}
+    Train_System(): train_db("train"), station_db("train_station"), station_dict("station_dict"), train_dict("train_dict"), train_index("station_index"),
+    pair_index("pair_index"), long_index("long_index"), seat_file("seat"),
+    order_db("order"), order_queue("order_queue") {}
     ~Train_System() = default;
 
     bool is_id_exist(const Mystring<21>& id)
@@ -45,8 +122,14 @@ public:
         return false;
     }
 
-    void add_train(const Mystring<21>& id, const Train_Data& data)
+    // stations are given by name and interned here
+    void add_train(const Mystring<21>& id, Train_Data& data, const vector<std::string>& stations)
     {
+        Train_Stations tmp;
+        for (int i = 0; i < data.station_num; i++)
+            tmp.id[i] = station_dict.insert(stations[i]);
+        data.stations = station_db.new_space();
+        station_db.write(data.stations, tmp);
         train_db.insert(id, data);
         std::cout << "0\n";
     }
@@ -55,6 +138,7 @@ public:
     {
         auto found = train_db.readonly(id);
         if (found == nullptr || found->released) return -1;
+        station_db.delete_space(found->stations);
         train_db.erase(id);
         return 0;
     }
@@ -64,22 +148,36 @@ public:
         auto found = train_db.readwrite(id);
         if (found == nullptr || found->released) return -1;
         found->released = true;
+        int train = found->serial = train_dict.insert(id); // interned when released
         Index_Info info;
         info.train_id = id;
+        auto stations = station_db.readonly(found->stations);
         for (char i = 0; i < found->station_num; i++)
         {
             info.num = i;
-            train_index.insert(found->stations[i], info);
+            train_index.insert(stations->id[i], info);
+            cache.touch_station(stations->id[i]);
         }
-        Seat_Index index;
-        index.id = id;
-        index.date = found->start_date;
-        Seats seats;
-        for (int i = 0; i < found->station_num - 1; i++)
-            seats[i] = found->seat;
-        for (; index.date < found->end_date; ++index.date)
-            seat_db.insert(index, seats);
-        seat_db.insert(index, seats);
+        if (found->station_num <= PAIR_LIMIT)
+        {
+            Pair_Info pair;
+            pair.train_id = id;
+            for (char i = 0; i < found->station_num; i++)
+                for (char j = i + 1; j < found->station_num; j++)
+                {
+                    pair.from = i;
+                    pair.to = j;
+                    pair_index.insert(pair_key(stations->id[i], stations->id[j]), pair);
+                }
+        }
+        else
+        {
+            for (char i = 0; i < found->station_num; i++)
+                long_index.insert(stations->id[i], train << 8 | i);
+        }
+        found->seats = seat_file.new_space((long)(found->end_date - found->start_date + 1) * Seats::size(found->station_num - 1));
+        route_built = false;
+        route_version++;
         return 0;
     }
 
@@ -96,15 +194,14 @@ public:
             std::cout << "-1\n";
             return;
         }
+        auto stations = station_db.readonly(found->stations);
         if (found->released)
         {
-            Seat_Index index;
-            index.date = d;
-            index.id = id;
-            auto seat = seat_db.readonly(index);
+            Seats sold(found->station_num - 1);
+            read_seat(found, d, sold);
             std::cout << id << ' ' << found->type << '\n';
-            std::cout << found->stations[0] << " xx-xx xx:xx -> " << d << ' ' << 
-            found->leave_time[0] << " 0 " << seat->s[0] << '\n';
+            std::cout << station_dict.name(stations->id[0]) << " xx-xx xx:xx -> " << d << ' ' << 
+            found->leave_time[0] << " 0 " << found->seat - sold[0] << '\n';
             Date day;
             Time t;
             for (char i = 1; i < found->station_num - 1; i++)
@@ -112,22 +209,22 @@ public:
                 day = d;
                 t = found->arrive_time[i-1];
                 adjust_date(day, t);
-                std::cout << found->stations[i] << ' ' << day << ' ' << t << " -> ";
+                std::cout << station_dict.name(stations->id[i]) << ' ' << day << ' ' << t << " -> ";
                 day = d;
                 t = found->leave_time[i];
                 adjust_date(day, t);
-                std::cout << day << ' ' << t << ' ' << found->price[i] << ' ' << seat->s[i] << '\n';
+                std::cout << day << ' ' << t << ' ' << found->price[i] << ' ' << found->seat - sold[i] << '\n';
             }
             day = d;
             t = found->arrive_time[found->station_num-2];
             adjust_date(day, t);
-            std::cout << found->stations[found->station_num-1] << ' ' << day << ' ' << t <<
+            std::cout << station_dict.name(stations->id[found->station_num-1]) << ' ' << day << ' ' << t <<
             " -> xx-xx xx:xx " << found->price[found->station_num-1] << " x\n";
         }
         else
         {
             std::cout << id << ' ' << found->type << '\n';
-            std::cout << found->stations[0] << " xx-xx xx:xx -> " << d << ' ' << 
+            std::cout << station_dict.name(stations->id[0]) << " xx-xx xx:xx -> " << d << ' ' << 
             found->leave_time[0] << " 0 " << found->seat << '\n';
             Date day;
             Time t;
@@ -136,7 +233,7 @@ public:
                 day = d;
                 t = found->arrive_time[i-1];
                 adjust_date(day, t);
-                std::cout << found->stations[i] << ' ' << day << ' ' << t << " -> ";
+                std::cout << station_dict.name(stations->id[i]) << ' ' << day << ' ' << t << " -> ";
                 day = d;
                 t = found->leave_time[i];
                 adjust_date(day, t);
@@ -145,137 +242,261 @@ public:
             day = d;
             t = found->arrive_time[found->station_num-2];
             adjust_date(day, t);
-            std::cout << found->stations[found->station_num-1] << ' ' << day << ' ' << t <<
+            std::cout << station_dict.name(stations->id[found->station_num-1]) << ' ' << day << ' ' << t <<
             " -> xx-xx xx:xx " << found->price[found->station_num-1] << " x\n";
         } 
     }
 
     // p = 0 for "-p time", p = 1 for "-p cost"
-    void query_ticket(const Mystring<31>& a, const Mystring<31>& b, Date d, bool p) 
+    // only the best k are printed if k >= 0
+    // every day from d to e is printed as if queried alone, sharing the join and the train reads
+    void query_ticket(const Mystring<31>& a, const Mystring<31>& b, Date d, Date e, bool p, int k = -1)
     {
+        if (e < d)
+        {
+            std::cout << "-1\n";
+            return;
+        }
+        int days = e - d + 1;
         vector<Index_Info> candidate;
         vector<char> to_num;
-        find_train(a, b, candidate, to_num);
+        int a_id = station_dict.find(a), b_id = station_dict.find(b);
+        bool known = a_id != -1 && b_id != -1;
+        // the days answered by the cache, empty if not
+        vector<std::string> hit;
+        vector<vector<Journey_Data>> res;
+        int need = 0;
+        Query_Cache::Query query = {0, p, d, a_id, b_id, k};
+        for (int j = 0; j < days; j++, ++query.d)
+        {
+            const std::string* cached = known ? cache.find(query) : nullptr;
+            hit.push_back(cached != nullptr ? *cached : std::string());
+            res.push_back(vector<Journey_Data>());
+            if (cached == nullptr) need++;
+        }
+        if (need && known)
+            find_train(a_id, b_id, candidate, to_num);
         int size = candidate.size();
         Journey_Data journey;
-        vector<Journey_Data> res;
+        auto comp = [](const Journey_Data& x, const Journey_Data& y)
+        {
+            if (x.key != y.key) return x.key < y.key;
+            return strcmp(x.train_id, y.train_id) < 0;
+        };
         for (int i = 0; i < size; ++i)
         {
+            // read the trains of the next batch together
+            if (i % MAX_BATCH == 0)
+            {
+                Mystring<21> ids[MAX_BATCH];
+                int num = std::min(size - i, MAX_BATCH);
+                for (int j = 0; j < num; j++)
+                    ids[j] = candidate[i+j].train_id;
+                train_db.prefetch(ids, num);
+            }
             auto train = train_db.readonly(candidate[i].train_id);
             // check validity
             if (candidate[i].num == train->station_num) continue;
-            Time origin_leave_time = journey.leave_time = train->leave_time[candidate[i].num];
-            int offset = 0;
-            while (journey.leave_time.h >= 24)
+            Time origin_leave_time = train->leave_time[candidate[i].num];
+            int offset = origin_leave_time.day();
+            journey.leave_time = origin_leave_time.clock();
+            // the days not cached that the train leaves a on, which are consecutive
+            int first = -1, last = -1;
+            Date first_day = d, first_date = d, day = d;
+            for (int j = 0; j < days; j++, ++day)
             {
-                ++offset;
-                journey.leave_time.h -= 24;
+                Date require_date = day - offset;
+                if (require_date < train->start_date || train->end_date < require_date || !hit[j].empty())
+                    continue;
+                if (first == -1)
+                {
+                    first = j;
+                    first_day = day;
+                    first_date = require_date;
+                }
+                last = j;
             }
-            Date require_date = d;
-            require_date -= offset;
-            if (require_date < train->start_date || train->end_date < require_date) continue;
+            if (first == -1) continue;
             // fill in information
             strcpy(journey.train_id, candidate[i].train_id.string);
-            journey.leave_date = d;
-            journey.arrive_date = require_date;
-            journey.arrive_time = train->arrive_time[to_num[i]-1];
-            journey.time = journey.arrive_time - origin_leave_time;
-            adjust_date(journey.arrive_date, journey.arrive_time);
+            journey.time = train->arrive_time[to_num[i]-1] - origin_leave_time;
             journey.price = train->price[to_num[i]] - train->price[candidate[i].num];
-            journey.seat = 1e9;
-            Seat_Index index;
-            index.id = candidate[i].train_id;
-            index.date = require_date;
-            auto seat = seat_db.readonly(index);
-            for (char j = candidate[i].num; j < to_num[i]; j++)
-                journey.seat = std::min(journey.seat, seat->s[j]);
-            res.push_back(journey);
-        }
-        size = res.size();
-        int* array = new int[size];
-        for (int i = 0; i < size; i++)
-            array[i] = i;
-        if (!p) // -p time
-        {
-            sort(array, array+size, 
-            [&res](int x, int y)
+            journey.key = p ? journey.price : journey.time;
+            // the seat rows of those days are read in one pass
+            int row = Seats::size(train->station_num - 1);
+            size_t span = (size_t)(last - first + 1) * row;
+            while (seat_span.size() < span) seat_span.push_back(0);
+            seat_file.read(seat_pos(train, first_date), &seat_span[0], span);
+            Seats sold(train->station_num - 1);
+            day = first_day;
+            for (int j = first; j <= last; j++, ++day)
             {
-                return res[x].time < res[y].time;
-            });
+                if (!hit[j].empty()) continue;
+                Date require_date = day - offset;
+                journey.leave_date = day;
+                journey.arrive_date = require_date;
+                journey.arrive_time = train->arrive_time[to_num[i]-1];
+                adjust_date(journey.arrive_date, journey.arrive_time);
+                memcpy(sold.data(), &seat_span[(j - first) * row], row * sizeof(int));
+                journey.seat = train->seat - sold.max(candidate[i].num, to_num[i]);
+                journey.seat_key = Query_Cache::seat_key(train->serial, require_date);
+                keep_journey(res[j], journey, k, comp);
+            }
         }
-        else // -p cost
+        query.d = d;
+        for (int j = 0; j < days; j++, ++query.d)
         {
-            sort(array, array+size, 
-            [&res](int x, int y)
+            if (!hit[j].empty())
             {
-                return res[x].price < res[y].price;
-            });
-        }
-        std::cout << size << '\n';
-        for (int i = 0; i < size; i++)
-        {
-            int j = array[i];
-            std::cout << res[j].train_id << ' ' << a << ' ' << res[j].leave_date << ' ' << res[j].leave_time << " -> " <<
-            b << ' ' << res[j].arrive_date << ' ' << res[j].arrive_time << ' ' << res[j].price << ' ' << res[j].seat << '\n';
+                out << hit[j].c_str();
+                continue;
+            }
+            int begin = out.size();
+            vector<Journey_Data>& day_res = res[j];
+            size = day_res.size();
+            if (size)
+                sort(&day_res[0], &day_res[0] + size, comp);
+            out << size << '\n';
+            for (int i = 0; i < size; i++)
+            {
+                out << day_res[i].train_id << ' ' << a << ' ' << day_res[i].leave_date << ' ' << day_res[i].leave_time << " -> " <<
+                b << ' ' << day_res[i].arrive_date << ' ' << day_res[i].arrive_time << ' ' << day_res[i].price << ' ' << day_res[i].seat << '\n';
+            }
+            if (known)
+            {
+                vector<long long> seats;
+                for (int i = 0; i < size; i++)
+                    seats.push_back(day_res[i].seat_key);
+                cache.insert(query, out.c_str() + begin, out.size() - begin, seats);
+            }
         }
+        out.flush(std::cout);
     }
 
     void query_transfer(const Mystring<31>& a, const Mystring<31>& b, Date d, bool p)
     {
         Transfer_Info info;
         info.cost = info.time = 1e9;
-        if (!find_transfer(a, b, d, p, info))
+        int a_id = station_dict.find(a), b_id = station_dict.find(b);
+        if (a_id == -1 || b_id == -1)
         {
             std::cout << "0\n";
             return;
         }
+        Query_Cache::Query query = {1, p, d, a_id, b_id, -1};
+        auto cached = cache.find(query);
+        if (cached != nullptr)
+        {
+            std::cout << *cached;
+            return;
+        }
+        vector<long long> seats;
+        if (!find_transfer(a_id, b_id, d, p, info))
+        {
+            out << "0\n";
+            cache.insert(query, out.c_str(), out.size(), seats);
+            out.flush(std::cout);
+            return;
+        }
         // print a_train info
         auto a_train = train_db.readonly(info.train_id[0]);
         Time a_leave_time = a_train->leave_time[info.f_id[0]], a_arrive_time = a_train->arrive_time[info.t_id[0]-1];
-        int a_offset = a_leave_time.h / 24;
-        a_leave_time.h %= 24;
-        Seat_Index a_index;
-        a_index.id = info.train_id[0];
-        Date a_arrive_date = a_index.date = d - a_offset;
+        int a_offset = a_leave_time.day();
+        a_leave_time = a_leave_time.clock();
+        Date a_arrive_date = d - a_offset;
+        int left = min_seat(a_train, a_arrive_date, info.f_id[0], info.t_id[0]);
+        seats.push_back(Query_Cache::seat_key(a_train->serial, a_arrive_date));
         adjust_date(a_arrive_date, a_arrive_time);
-        auto a_seat = seat_db.readonly(a_index);
-        int left = 1e9;
-        for (int i = info.f_id[0]; i < info.t_id[0]; i++)
-            left = std::min(left, a_seat->s[i]);
-        std::cout << info.train_id[0] << ' ' << a << ' ' << d << ' ' << a_leave_time << " -> " << a_train->stations[info.t_id[0]] << ' ' << 
+        out << info.train_id[0] << ' ' << a << ' ' << d << ' ' << a_leave_time << " -> " << station_dict.name(station_db.readonly(a_train->stations)->id[info.t_id[0]]) << ' ' << 
         a_arrive_date << ' ' << a_arrive_time << ' ' << a_train->price[info.t_id[0]] - a_train->price[info.f_id[0]] << ' ' << left << '\n';
         // print b_train info
         auto b_train = train_db.readonly(info.train_id[1]);
         Time b_leave_time = b_train->leave_time[info.f_id[1]], b_arrive_time = b_train->arrive_time[info.t_id[1]-1];
-        Seat_Index b_index;
-        b_index.id = info.train_id[1];
-        Date b_leave_date = b_index.date = info.date;
+        Date b_leave_date = info.date;
         Date b_arrive_date = b_leave_date;
         adjust_date(b_leave_date, b_leave_time);
         adjust_date(b_arrive_date, b_arrive_time);
-        auto b_seat = seat_db.readonly(b_index);
-        left = 1e9;
-        for (int i = info.f_id[1]; i < info.t_id[1]; i++)
-            left = std::min(left, b_seat->s[i]);
-        std::cout << info.train_id[1] << ' ' << b_train->stations[info.f_id[1]] << ' ' << b_leave_date << ' ' << b_leave_time << " -> " << b << ' ' <<
+        left = min_seat(b_train, info.date, info.f_id[1], info.t_id[1]);
+        seats.push_back(Query_Cache::seat_key(b_train->serial, info.date));
+        out << info.train_id[1] << ' ' << station_dict.name(station_db.readonly(b_train->stations)->id[info.f_id[1]]) << ' ' << b_leave_date << ' ' << b_leave_time << " -> " << b << ' ' <<
         b_arrive_date << ' ' << b_arrive_time << ' ' << b_train->price[info.t_id[1]] - b_train->price[info.f_id[1]] << ' ' << left << '\n';
+        cache.insert(query, out.c_str(), out.size(), seats);
+        out.flush(std::cout);
+    }
+
+    // Pareto-optimal journeys of at most MAX_LEGS legs leaving a on d, by arrival time and price;
+    // every leg leaves within ROUTE_DAYS days from d
+    void query_route(const Mystring<31>& a, const Mystring<31>& b, Date d)
+    {
+        int a_id = station_dict.find(a), b_id = station_dict.find(b);
+        if (a_id == -1 || b_id == -1)
+        {
+            std::cout << "0\n";
+            return;
+        }
+        if (!route_built || !(route_date == d))
+            build_route(d);
+        vector<Route_Engine::Journey> res;
+        route_search++;
+        seat_left.clear();
+        route.search(a_id, b_id, 1440, [this](int trip, int num)
+        {
+            // the row of a trip is read once a search, when it is first checked
+            Route_Trip& r = trips[trip];
+            if (r.stamp != route_search)
+            {
+                Seats sold(r.len);
+                seat_file.read(r.pos, sold.data(), sold.size());
+                r.stamp = route_search;
+                r.left = seat_left.size();
+                for (int k = 0; k < r.len; k++)
+                    seat_left.push_back(r.seat - sold.max(k, k + 1));
+            }
+            return seat_left[r.left + num] > 0;
+        }, res);
+        out << (int)res.size() << '\n';
+        for (int i = 0; i < (int)res.size(); i++)
+        {
+            out << res[i].legs << ' ' << res[i].price << ' ' << res[i].arrive - res[i].leave << '\n';
+            for (int j = 0; j < res[i].legs; j++)
+            {
+                const Connection& board = route.connection(res[i].leg[j].board);
+                const Connection& alight = route.connection(res[i].leg[j].alight);
+                const Route_Trip& r = trips[board.trip];
+                const Mystring<21>& id = train_dict.name(r.train);
+                auto train = train_db.readonly(id);
+                int f = board.num, t = alight.num + 1;
+                Date leave_date = r.date, arrive_date = r.date;
+                Time leave_time = train->leave_time[f], arrive_time = train->arrive_time[t-1];
+                adjust_date(leave_date, leave_time);
+                adjust_date(arrive_date, arrive_time);
+                out << id << ' ' << station_dict.name(board.from) << ' ' << leave_date << ' ' << leave_time << " -> " <<
+                station_dict.name(alight.to) << ' ' << arrive_date << ' ' << arrive_time << ' ' <<
+                train->price[t] - train->price[f] << ' ' << min_seat(train, r.date, f, t) << '\n';
+            }
+        }
+        out.flush(std::cout);
     }
 
-    void buy_ticket(const Mystring<21>& u, const Mystring<21>& id, Date d,
+    // prev is the user's newest order, -1 for none
+    // returns the address of the new order, or -1 if none is made
+    long buy_ticket(long prev, const Mystring<21>& id, Date d,
                     const Mystring<31>& from, const Mystring<31>& to, int n, bool q)
     {
         auto train = train_db.readonly(id);
         if (train == nullptr || !train->released)
         {
             std::cout << "-1\n";
-            return;
+            return -1;
         }
         int f_id = -1, t_id = -1;
+        int from_id = station_dict.find(from), to_id = station_dict.find(to);
+        auto stations = station_db.readonly(train->stations);
         for (int i = 0; i < train->station_num; i++)
         {
-            if (!strcmp(from.string, train->stations[i]))
+            if (stations->id[i] == from_id)
                 f_id = i;
-            else if (!strcmp(to.string, train->stations[i]))
+            else if (stations->id[i] == to_id)
             {
                 t_id = i;
                 break;
@@ -284,142 +505,236 @@ public:
         if (f_id == -1 || t_id == -1)
         {
             std::cout << "-1\n";
-            return;
+            return -1;
         }
         Seat_Index index;
         index.id = id;
-        int offset = train->leave_time[f_id].h / 24;
+        int offset = train->leave_time[f_id].day();
         index.date = d - offset;
-        auto seat = seat_db.readonly(index);
-        if (seat == nullptr)
+        if (index.date < train->start_date || train->end_date < index.date)
         {
             std::cout << "-1\n";
-            return;
+            return -1;
         }
-        int left = 1e9;
-        for (int i = f_id; i < t_id; i++)
-            left = std::min(left, seat->s[i]);
+        int left = min_seat(train, index.date, f_id, t_id);
         if ((left < n && !q) || n > train->seat)
         {
             std::cout << "-1\n";
-            return;
+            return -1;
         }
         Order_Data order;
-        strcpy(order.train_id, id.string);
-        order.d = index.date;
+        order.serial = train->serial;
+        order.day = index.date - train->start_date; // the sale range lies in a year, see DAY_BITS
         order.f_id = f_id;
         order.t_id = t_id;
         order.num = n;
+        order.prev = prev;
+        long address = order_db.new_space();
         if (left >= n)
         {
             order.state = 1;
-            long address = order_db.new_space();
-            order_index.insert(u, -address);
             order_db.write(address, order);
-            auto seat2 = seat_db.readwrite(index);
-            for (int i = f_id; i < t_id; i++)
-                seat2->s[i] -= n;
+            Seats sold(train->station_num - 1);
+            read_seat(train, index.date, sold);
+            sold.add(f_id, t_id, n);
+            write_seat(train, index.date, sold);
+            cache.touch_seat(Query_Cache::seat_key(train->serial, index.date));
             std::cout << (long long)n * (train->price[t_id] - train->price[f_id]) << '\n';
-            return;
+            return address;
         }
         order.state = 0;
-        long address = order_db.new_space();
-        order_index.insert(u, -address);
         order_db.write(address, order);
-        order_queue.insert(index, address);
+        Queue_Info wait;
+        wait.address = address;
+        wait.f_id = f_id;
+        wait.t_id = t_id;
+        wait.num = n;
+        order_queue.insert(Queue_Key(index, f_id), wait);
         std::cout << "queue\n";
+        return address;
     }
 
-    void query_order(const Mystring<21>& u)
+    // orders are chained from the newest one at head
+    // the trains in them are looked up once each, together and in the order of train id
+    void query_order(long head, int count)
     {
-        vector<long> res;
-        order_index.find(u, res);
-        std::cout << res.size() << '\n';
-        for (auto i = res.begin(); i != res.end(); i++)
+        vector<Order_Data> orders;
+        orders.reserve(count);
+        vector<int> serial; // of the distinct trains, sorted
+        for (long i = head; i != -1; )
+        {
+            auto order = order_db.readonly(i);
+            orders.push_back(*order);
+            serial.push_back(order->serial);
+            i = order->prev;
+        }
+        int size = 0;
+        if (!serial.empty())
+        {
+            sort(&serial[0], &serial[0] + serial.size(), [](int x, int y) { return x < y; });
+            for (int i = 0; i < (int)serial.size(); i++)
+                if (!size || serial[i] != serial[size-1])
+                    serial[size++] = serial[i];
+        }
+        // by position in serial
+        vector<Order_Train> trains;
+        trains.reserve(size);
+        vector<int> by_id;
+        for (int i = 0; i < size; i++)
         {
-            auto order = order_db.readonly(-*i);
-            auto train = train_db.readonly(order->train_id);
-            if (order->state == 1)
-                std::cout << "[success] ";
-            else if (!order->state)
-                std::cout << "[pending] ";
+            Order_Train tmp;
+            tmp.id = train_dict.name(serial[i]);
+            trains.push_back(tmp);
+            by_id.push_back(i);
+        }
+        if (size)
+            sort(&by_id[0], &by_id[0] + size, [&trains](int x, int y) { return trains[x].id < trains[y].id; });
+        for (int i = 0; i < size; i++)
+        {
+            if (i % MAX_BATCH == 0)
+            {
+                Mystring<21> ids[MAX_BATCH];
+                int num = std::min(size - i, MAX_BATCH);
+                for (int j = 0; j < num; j++)
+                    ids[j] = trains[by_id[i+j]].id;
+                train_db.prefetch(ids, num);
+            }
+            Order_Train& train = trains[by_id[i]];
+            train.data = *train_db.readonly(train.id);
+            train.stations = *station_db.readonly(train.data.stations);
+        }
+        out << count << '\n';
+        for (int i = 0; i < (int)orders.size(); i++)
+        {
+            const Order_Data& order = orders[i];
+            const Order_Train& train = trains[lower_bound(&serial[0], &serial[0] + size, (int)order.serial,
+                [](int x, int y) { return x < y; }) - &serial[0]];
+            if (order.state == 1)
+                out << "[success] ";
+            else if (!order.state)
+                out << "[pending] ";
             else
-                std::cout << "[refunded] ";
-            std::cout << order->train_id << ' ';
-            std::cout << train->stations[order->f_id] << ' ';
-            Date d = order->d;
-            Time t = train->leave_time[order->f_id];
+                out << "[refunded] ";
+            out << train.id << ' ' << station_dict.name(train.stations.id[order.f_id]) << ' ';
+            Date date = train.data.start_date + order.day;
+            Date d = date;
+            Time t = train.data.leave_time[order.f_id];
             adjust_date(d, t);
-            std::cout << d << ' ' << t << " -> ";
-            std::cout << train->stations[order->t_id] << ' ';
-            d = order->d;
-            t = train->arrive_time[order->t_id-1];
+            out << d << ' ' << t << " -> " << station_dict.name(train.stations.id[order.t_id]) << ' ';
+            d = date;
+            t = train.data.arrive_time[order.t_id-1];
             adjust_date(d, t);
-            std::cout << d << ' ' << t << ' ';
-            std::cout << train->price[order->t_id] - train->price[order->f_id] << ' ';
-            std::cout << order->num << '\n';
+            out << d << ' ' << t << ' ' << train.data.price[order.t_id] - train.data.price[order.f_id] << ' ' <<
+            (int)order.num << '\n';
         }
+        out.flush(std::cout);
     }
 
-    int refund_ticket(const Mystring<21>& u, int n)
+    // refund the n-th newest order, counted from 0, of the orders chained from head
+    int refund_ticket(long head, int count, int n)
     {
-        vector<long> order_v;
-        order_index.find(u, order_v);
-        if (n >= order_v.size()) return -1;
-        auto order = order_db.readwrite(-order_v[n]);
+        if (n < 0 || n >= count) return -1;
+        long address = head;
+        for (int i = 0; i < n; i++)
+            address = order_db.readonly(address)->prev;
+        auto order = order_db.readwrite(address);
         if (order->state == -1) return -1;
         Seat_Index index;
-        index.id = order->train_id;
-        index.date = order->d;
+        index.id = train_dict.name(order->serial);
+        auto train = train_db.readonly(index.id);
+        index.date = train->start_date + order->day;
+        Queue_Info wait;
         if (order->state == 0)
         {
             order->state = -1;
-            order_queue.erase(index, -order_v[n]);
+            wait.address = address;
+            order_queue.erase(Queue_Key(index, order->f_id), wait);
             return 0;
         }
         order->state = -1;
-        auto seat = seat_db.readwrite(index);
-        for (int i = order->f_id; i < order->t_id; i++)
-            seat->s[i] += order->num;
-        vector<long> queue;
-        order_queue.find(index, queue);
-        for (auto it = queue.begin(); it != queue.end(); it++)
-        {
-            auto cptr = order_db.readonly(*it);
-            int left = 1e9;
-            for (int i = cptr->f_id; i < cptr->t_id; i++)
-                left = std::min(seat->s[i], left);
-            if (left < cptr->num) continue;
-            auto ptr = order_db.readwrite(*it);
-            ptr->state = 1;
-            for (int i = cptr->f_id; i < cptr->t_id; i++)
-                seat->s[i] -= cptr->num;
-            order_queue.erase(index, *it);
+        int f_id = order->f_id, t_id = order->t_id;
+        Seats sold(train->station_num - 1);
+        read_seat(train, index.date, sold);
+        sold.add(f_id, t_id, -order->num);
+        // seats are only freed in [f_id, t_id), so only the orders boarding before t_id are read
+        // and those getting off by f_id are passed over; they are served first come first
+        vector<Queue_Info> queue;
+        order_queue.find_range(Queue_Key(index, 0), Queue_Key(index, t_id), queue);
+        if (!queue.empty())
+            sort(&queue[0], &queue[0] + queue.size(), [](const Queue_Info& a, const Queue_Info& b)
+            {
+                return a.address < b.address;
+            });
+        for (int i = 0; i < (int)queue.size(); i++)
+        {
+            const Queue_Info& cur = queue[i];
+            if (cur.t_id <= f_id) continue;
+            if (train->seat - sold.max(cur.f_id, cur.t_id) < cur.num) continue;
+            order_db.readwrite(cur.address)->state = 1;
+            sold.add(cur.f_id, cur.t_id, cur.num);
+            order_queue.erase(Queue_Key(index, cur.f_id), cur);
         }
+        write_seat(train, index.date, sold);
+        cache.touch_seat(Query_Cache::seat_key(train->serial, index.date));
         return 0;
     }
 
     void clean()
     {
         train_db.clean();
+        station_db.clean();
+        station_dict.clean();
+        train_dict.clean();
         train_index.clean();
+        pair_index.clean();
+        long_index.clean();
         order_db.clean();
-        order_index.clean();
         order_queue.clean();
+        seat_file.clean();
+        cache.clean();
+        route_built = false;
+        route_version++;
+        route_trains.clear();
+        route_legs.clear();
+        trip_stamp.clear();
+        trip_base.clear();
+    }
+
+    const Query_Cache& query_cache() const
+    {
+        return cache;
+    }
+
+    // share of the allocated station_db slots in use, the slots delete_train frees are reused
+    double station_fill() const
+    {
+        return station_db.fill_factor();
     }
 
 private:
+    // packed into 8 bytes besides prev
     struct Order_Data
     {
-        signed char state;// -1 for refunded, 0 for pending, 1 for success
-        char f_id;
-        char t_id;
-        Date d; // departure date of the train, not the order
-        char train_id[21];
-        int num;
+        long prev; // the previous order of the user, -1 for none
+        unsigned serial : 32 - DAY_BITS - 2; // id of the train in train_dict
+        signed state : 2; // -1 for refunded, 0 for pending, 1 for success
+        unsigned day : DAY_BITS; // days from the start date of the train to its departure
+        unsigned num : 18;
+        unsigned f_id : 7;
+        unsigned t_id : 7;
+    };
+    static_assert((1 << DAY_BITS) >= MAX_SALE_DAYS, "Order_Data::day must hold any day of a sale range");
+    static_assert(sizeof(Order_Data) == 16, "Order_Data must stay packed");
+    struct Order_Train
+    {
+        Mystring<21> id;
+        Train_Data data;
+        Train_Stations stations;
     };
     struct Journey_Data
     {
+        int key; // time or price, whichever is sorted by
+        long long seat_key; // train-day for the query cache
         int time;
         int price;
         int seat;
@@ -442,29 +757,37 @@ private:
             return a.train_id == b.train_id;
         }
     };
-    struct Seat_Index
+    struct Pair_Info
     {
-        Date date;
-        Mystring<21> id;
-        friend bool operator<(const Seat_Index& a, const Seat_Index& b)
+        char from;
+        char to;
+        Mystring<21> train_id;
+        friend bool operator<(const Pair_Info& a, const Pair_Info& b)
         {
-            int res = strcmp(a.id.string, b.id.string);
-            if (res) return res < 0;
-            return a.date < b.date;
+            return a.train_id < b.train_id;
         }
-        friend bool operator==(const Seat_Index& a, const Seat_Index& b)
+        friend bool operator==(const Pair_Info& a, const Pair_Info& b)
         {
-            return a.id == b.id && a.date == b.date;
+            return a.train_id == b.train_id;
         }
     };
-    struct Seats
+    // a pending order, with its sections and number so that a refund need not read it
+    struct Queue_Info
     {
-        int s[MAXSTA-1];
-        int& operator[](int i)
+        long address; // in order_db
+        char f_id;
+        char t_id;
+        int num;
+        friend bool operator<(const Queue_Info& a, const Queue_Info& b)
         {
-            return s[i];
+            return a.address < b.address;
+        }
+        friend bool operator==(const Queue_Info& a, const Queue_Info& b)
+        {
+            return a.address == b.address;
         }
     };
+    typedef Seat_Row<MAXSTA-1> Seats;
     struct Transfer_Info
     {
         int time;
@@ -474,55 +797,360 @@ private:
         char f_id[2];
         char t_id[2];
     };
-    BPT<Mystring<21>, Train_Data> train_db;
-    Multi_BPT<Mystring<31>, Index_Info> train_index; // station name as index
-    BPT<Seat_Index, Seats> seat_db;
+    struct Transfer_Leg
+    {
+        int index; // in the trains through b
+        Train_Data train;
+        Train_Stations stations;
+    };
+    struct alignas(64) Transfer_Best
+    {
+        Transfer_Info info;
+        long long order = 0; // position in the serial search
+        bool found = false;
+    };
+    BPT<Mystring<21>, Train_Data, Bloom_Filter> train_db;
+    Datafile<Train_Stations> station_db;
+    Dictionary<31> station_dict;
+    Dictionary<21> train_dict;
+    Multi_BPT<int, Index_Info> train_index; // station id as index
+    Multi_BPT<long long, Pair_Info> pair_index; // pair_key of two stations as index, trains of at most PAIR_LIMIT stations
+    Multi_BPT<int, int> long_index; // station id as index, train << 8 | num as value, trains of more than PAIR_LIMIT stations
+    Seatfile seat_file;
+    Buffer out; // for the output of a query
+    vector<int> seat_span; // seat rows of consecutive days read by query_ticket
+    struct Reach
+    {
+        int index; // in the trains through a
+        char t_id;
+        Time leave; // of train[0] at a
+        Time arrive; // of train[0] at the station
+        int price; // of train[0] from a to the station
+        int next;
+    };
+    vector<Reach> reach; // reach table of find_transfer, kept to reuse the memory
+    int reach_num = 0; // entries of reach in use
+    vector<int> reach_head;
+    vector<int> reach_tail;
+    vector<int> reach_stamp;
+    int stamp = 0;
+    Query_Cache cache; // of query_ticket and query_transfer output
+    struct Route_Trip
+    {
+        int train; // id in train_dict
+        Date date; // departure date of the train
+        long pos; // of its row in seat_file
+        char len;
+        int seat;
+        int stamp; // of route_search when its row was read
+        int left; // its seats left by section in seat_left
+    };
+    Route_Engine route; // connections of the days from route_date, rebuilt when a train is released
+    vector<Route_Trip> trips; // by trip of the connections
+    Date route_date;
+    bool route_built = false;
+    int route_search = 0;
+    vector<int> seat_left;
+    // the released trains kept in memory for query_route, by serial
+    struct Route_Train
+    {
+        Date start_date;
+        Date end_date;
+        long seats;
+        int seat;
+        char len; // legs
+        char span; // days from the departure to the arrival at the terminal
+        int leg; // first of its legs in route_legs
+    };
+    vector<Route_Train> route_trains;
+    vector<Connection> route_legs; // times from the departure midnight, trip is the serial
+    vector<int> trip_stamp; // by serial, trip_base is valid when it equals route_stamp
+    vector<int> trip_base; // first trip of the train in the route engine
+    int route_stamp = 0;
+    // a connection leaving on a day, times from its midnight, trip is the serial
+    struct Route_Conn
+    {
+        Connection c;
+        char back; // days since the departure of the train
+    };
+    // the connections by day, reused by queries of nearby dates till a train is released
+    struct Route_Day
+    {
+        Date date;
+        int version = -1; // of route_version
+        int used = 0;
+        vector<Route_Conn> conn;
+    };
+    Route_Day route_days[ROUTE_CACHE];
+    int route_version = 0;
+    int route_clock = 0;
     Datafile<Order_Data> order_db;
-    Multi_BPT<Mystring<21>, long> order_index; // long is -address in order_db, username as index
-    Multi_BPT<Seat_Index, long> order_queue; // long is address in order_db
+    Multi_BPT<Queue_Key, Queue_Info> order_queue; // pending orders of a train-day by boarding station, then address
+
+    // position in seat_file of the row of a released train departing on d
+    inline long seat_pos(const Train_Data* train, Date d) const
+    {
+        return train->seats + (long)(d - train->start_date) * Seats::size(train->station_num - 1);
+    }
+
+    void read_seat(const Train_Data* train, Date d, Seats& sold)
+    {
+        seat_file.read(seat_pos(train, d), sold.data(), sold.size());
+    }
+
+    void write_seat(const Train_Data* train, Date d, Seats& sold)
+    {
+        seat_file.write(seat_pos(train, d), sold.data(), sold.size());
+    }
+
+    // the least seats left from station f to t
+    int min_seat(const Train_Data* train, Date d, int f, int t)
+    {
+        Seats sold(train->station_num - 1);
+        read_seat(train, d, sold);
+        return train->seat - sold.max(f, t);
+    }
+
+    // add to the result of a day, keeping only the best k in a heap with the worst on top if k >= 0
+    template<typename Compare>
+    static void keep_journey(vector<Journey_Data>& res, const Journey_Data& journey, int k, Compare comp)
+    {
+        if (k < 0)
+            res.push_back(journey);
+        else if ((int)res.size() < k)
+        {
+            res.push_back(journey);
+            push_heap(&res[0], &res[0] + res.size(), comp);
+        }
+        else if (k && comp(journey, res[0]))
+        {
+            pop_heap(&res[0], &res[0] + res.size(), comp);
+            res[res.size()-1] = journey;
+            push_heap(&res[0], &res[0] + res.size(), comp);
+        }
+    }
 
-    // find all trains that go from a to b
-    void find_train(const Mystring<31>& a, const Mystring<31>& b, vector<Index_Info>& res, vector<char>& to_num)
+    static inline long long pair_key(int a, int b)
     {
-        vector<Index_Info> av, bv;
-        train_index.find(a, av);
+        return (long long)a << 32 | b;
+    }
+
+    // find all trains that go from a to b, in the order of train id
+    void find_train(int a, int b, vector<Index_Info>& res, vector<char>& to_num)
+    {
+        vector<Pair_Info> pairs, long_res;
+        pair_index.find(pair_key(a, b), pairs);
+        join_train(a, b, long_res);
+        res.reserve(pairs.size() + long_res.size());
+        to_num.reserve(pairs.size() + long_res.size());
+        // merge the two lists
+        Index_Info info;
+        int i = 0, j = 0;
+        while (i < (int)pairs.size() || j < (int)long_res.size())
+        {
+            const Pair_Info& next = (j == (int)long_res.size() || (i < (int)pairs.size() && pairs[i] < long_res[j])) ?
+                pairs[i++] : long_res[j++];
+            info.num = next.from;
+            info.train_id = next.train_id;
+            res.push_back(info);
+            to_num.push_back(next.to);
+        }
+    }
+
+    // find the trains in long_index that go from a to b
+    void join_train(int a, int b, vector<Pair_Info>& res)
+    {
+        vector<int> av, bv;
+        long_index.find(a, av);
         if (av.empty()) return;
-        train_index.find(b, bv);
+        long_index.find(b, bv);
         if (bv.empty()) return;
-        auto aptr = av.begin();
-        auto bptr = bv.begin();
-        int toreserve = std::min(av.size(), bv.size());
-        res.reserve(toreserve);
-        to_num.reserve(toreserve);
-        while (true)
-        {
-            while (aptr != av.end() && (*aptr).train_id < (*bptr).train_id) ++aptr;
-            if (aptr == av.end()) return;
-            if ((*aptr).train_id == (*bptr).train_id)
+        vector<pair<int, int>> match;
+        intersect(&av[0], av.size(), &bv[0], bv.size(), 8, match);
+        Pair_Info info;
+        for (auto it = match.begin(); it != match.end(); it++)
+        {
+            info.from = av[(*it).first] & 255;
+            info.to = bv[(*it).second] & 255;
+            if (info.from >= info.to) continue;
+            info.train_id = train_dict.name(av[(*it).first] >> 8);
+            res.push_back(info);
+        }
+        // interned ids are not in the order of train id
+        if (!res.empty())
+            sort(&res[0], &res[0] + res.size(),
+            [](const Pair_Info& x, const Pair_Info& y)
             {
-                if ((*aptr).num < (*bptr).num)
-                {
-                    res.push_back(*aptr);
-                    to_num.push_back((*bptr).num);
-                }
-                ++aptr;
+                return x < y;
+            });
+    }
+
+    // the reach table: stations reached by trains from a, as lists in
+    // insertion order directly addressed by station id; a list is empty
+    // unless its stamp is the current one, so clearing is O(1)
+    void reach_clear()
+    {
+        stamp++;
+        reach_num = 0;
+        while ((int)reach_stamp.size() < station_dict.id_count())
+        {
+            reach_stamp.push_back(0);
+            reach_head.push_back(-1);
+            reach_tail.push_back(-1);
+        }
+    }
+
+    void reach_insert(int station, int index, char t_id, Time leave, Time arrive, int price)
+    {
+        Reach tmp;
+        tmp.index = index;
+        tmp.t_id = t_id;
+        tmp.leave = leave;
+        tmp.arrive = arrive;
+        tmp.price = price;
+        tmp.next = -1;
+        int pos = reach_num++;
+        if (pos < (int)reach.size())
+            reach[pos] = tmp;
+        else
+            reach.push_back(tmp);
+        if (reach_stamp[station] != stamp)
+        {
+            reach_stamp[station] = stamp;
+            reach_head[station] = pos;
+        }
+        else
+            reach[reach_tail[station]].next = pos;
+        reach_tail[station] = pos;
+    }
+
+    // add the trains released since the last query_route to the timetable in memory
+    void load_route_trains()
+    {
+        Route_Train t;
+        Connection c;
+        for (int i = route_trains.size(); i < train_dict.id_count(); i++)
+        {
+            auto train = train_db.readonly(train_dict.name(i));
+            int n = train->station_num;
+            t.start_date = train->start_date;
+            t.end_date = train->end_date;
+            t.seats = train->seats;
+            t.seat = train->seat;
+            t.len = n - 1;
+            t.span = train->arrive_time[n-2].day();
+            t.leg = route_legs.size();
+            for (int j = 0; j < n - 1; j++)
+            {
+                c.leave = train->leave_time[j].m;
+                c.arrive = train->arrive_time[j].m;
+                c.price = train->price[j+1] - train->price[j];
+                c.trip = i;
+                c.num = j;
+                route_legs.push_back(c);
+            }
+            auto stations = station_db.readonly(train->stations);
+            for (int j = 0; j < n - 1; j++)
+            {
+                route_legs[t.leg + j].from = stations->id[j];
+                route_legs[t.leg + j].to = stations->id[j+1];
+            }
+            route_trains.push_back(t);
+            trip_stamp.push_back(0);
+            trip_base.push_back(0);
+        }
+    }
+
+    // the connections leaving on d in the order of leave, built from the timetable if not cached
+    const vector<Route_Conn>& route_day(Date d)
+    {
+        int slot = 0, least = -1;
+        for (int i = 0; i < ROUTE_CACHE; i++)
+        {
+            Route_Day& day = route_days[i];
+            int used = day.version == route_version ? day.used : -1;
+            if (used != -1 && day.date == d)
+            {
+                day.used = ++route_clock;
+                return day.conn;
+            }
+            if (least == -1 || used < least)
+            {
+                slot = i;
+                least = used;
+            }
+        }
+        Route_Day& day = route_days[slot];
+        day.date = d;
+        day.version = route_version;
+        day.used = ++route_clock;
+        day.conn.clear();
+        Route_Conn rc;
+        for (int i = 0; i < (int)route_trains.size(); i++)
+        {
+            const Route_Train& t = route_trains[i];
+            for (int j = 0; j < t.len; j++)
+            {
+                rc.c = route_legs[t.leg + j];
+                rc.back = rc.c.leave / 1440;
+                Date departure = d - rc.back;
+                if (departure < t.start_date || t.end_date < departure) continue;
+                rc.c.leave -= rc.back * 1440;
+                rc.c.arrive -= rc.back * 1440;
+                day.conn.push_back(rc);
             }
-            ++bptr;
-            if (aptr == av.end() || bptr == bv.end()) return;
-            while (bptr != bv.end() && (*bptr).train_id < (*aptr).train_id) ++bptr;
-            if (bptr == bv.end()) return;
-            if ((*aptr).train_id == (*bptr).train_id)
+        }
+        if (!day.conn.empty())
+            sort(&day.conn[0], &day.conn[0] + day.conn.size(), [](const Route_Conn& x, const Route_Conn& y)
             {
-                if ((*aptr).num < (*bptr).num)
+                if (x.c.leave != y.c.leave) return x.c.leave < y.c.leave;
+                if (x.c.trip != y.c.trip) return x.c.trip < y.c.trip;
+                if (x.back != y.back) return x.back > y.back;
+                return x.c.num < y.c.num;
+            });
+        return day.conn;
+    }
+
+    // put the connections leaving in ROUTE_DAYS days from d into the route engine
+    void build_route(Date d)
+    {
+        load_route_trains();
+        route.clear();
+        trips.clear();
+        route_stamp++;
+        Route_Trip r;
+        r.stamp = 0;
+        for (int k = 0; k < ROUTE_DAYS; k++)
+        {
+            const vector<Route_Conn>& day = route_day(d + k);
+            for (int i = 0; i < (int)day.size(); i++)
+            {
+                Connection c = day[i].c;
+                int serial = c.trip;
+                const Route_Train& t = route_trains[serial];
+                if (trip_stamp[serial] != route_stamp)
                 {
-                    res.push_back(*aptr);
-                    to_num.push_back((*bptr).num);
+                    // a trip for each day the train may leave on to run in the window
+                    trip_stamp[serial] = route_stamp;
+                    trip_base[serial] = trips.size();
+                    for (int j = -t.span; j < ROUTE_DAYS; j++)
+                    {
+                        r.train = serial;
+                        r.date = d + j;
+                        r.pos = t.seats + (long)(r.date - t.start_date) * Seats::size(t.len);
+                        r.len = t.len;
+                        r.seat = t.seat;
+                        trips.push_back(r);
+                    }
                 }
-                ++bptr;
+                c.trip = trip_base[serial] + t.span + k - day[i].back;
+                c.leave += k * 1440;
+                c.arrive += k * 1440;
+                route.add(c);
             }
-            ++aptr;
-            if (aptr == av.end() || bptr == bv.end()) return; 
         }
+        route_date = d;
+        route_built = true;
     }
 
     static bool transfer_comp_time(const Transfer_Info& a, const Transfer_Info& b)
@@ -544,105 +1172,130 @@ private:
     }
 
     // find the best transfer info
-    bool find_transfer(const Mystring<31>& a, const Mystring<31>& b, Date d, bool p, Transfer_Info& ret)
+    bool find_transfer(int a, int b, Date d, bool p, Transfer_Info& ret)
     {
         bool (*comp)(const Transfer_Info& a, const Transfer_Info& b);
         if (!p) comp = transfer_comp_time;
         else comp = transfer_comp_cost;
-        bool flag = false;
         vector<Index_Info> a_index, b_index;
         train_index.find(a, a_index);
-        // from_a: station as index, pair<id in a_index, t_id> as value
-        map<Mystring<31>, vector<pair<int, char>>> from_a;
-        // insert reachable city into from_a
+        // insert reachable city into the reach table
+        reach_clear();
         for (int i = 0; i < a_index.size(); i++)
         {
             // check date
             auto train = train_db.readonly(a_index[i].train_id);
-            int offset = train->leave_time[a_index[i].num].h / 24;
+            char f_id = a_index[i].num;
+            int offset = train->leave_time[f_id].day();
             Date require_d = d - offset;
             if (require_d < train->start_date || train->end_date < require_d)
                 continue;
             // insert
-            for (char j = a_index[i].num + 1; j < train->station_num; j++)
-            {
-                if (train->stations[j] == b) continue;
-                pair<int, char> toinsert(i, j);
-                auto found = from_a.find(train->stations[j]);
-                if (found == from_a.end())
-                {
-                    vector<pair<int, char>> tmp_v;
-                    tmp_v.push_back(toinsert);
-                    from_a.insert(pair<Mystring<31>, vector<pair<int, char>>>(train->stations[j], tmp_v));
-                }
-                else
-                    found->second.push_back(toinsert);
-            }
+            auto stations = station_db.readonly(train->stations);
+            for (char j = f_id + 1; j < train->station_num; j++)
+                if (stations->id[j] != b)
+                    reach_insert(stations->id[j], i, j, train->leave_time[f_id], train->arrive_time[j-1],
+                        train->price[j] - train->price[f_id]);
         }
-        if (from_a.empty()) return flag;
-        // iterate over trains passing by b
+        if (!reach_num) return false;
+        // load trains passing by b, which may go after a day when checked roughly
         train_index.find(b, b_index);
-        Transfer_Info tmp_info;
+        vector<Transfer_Leg> legs;
+        Transfer_Leg leg;
         for (int i = 0; i < b_index.size(); i++)
         {
-            // check date (roughly)
             char b_id = b_index[i].num;
             auto b_train = train_db.readonly(b_index[i].train_id);
-            char offset = b_train->arrive_time[b_id-1].h / 24;
-            Time b_arrive_t = b_train->arrive_time[b_id];
-            b_arrive_t.h -= 24 * offset;
-            Date require_d = d - offset;
-            if (b_train->end_date < require_d)
+            int offset = b_train->arrive_time[b_id-1].day();
+            if (b_train->end_date < d - offset)
                 continue;
-            // iterate over stations earlier than b
-            tmp_info.train_id[1] = b_index[i].train_id;
-            tmp_info.t_id[1] = b_id;
-            for (int j = 0; j < b_id; j++)
+            leg.index = i;
+            leg.train = *b_train;
+            leg.stations = *station_db.readonly(b_train->stations);
+            legs.push_back(leg);
+        }
+        // search the trains by b in parallel, ties go to the one the serial loop meets first
+        Transfer_Best best[MAX_THREADS];
+        auto task = [&](int t, int w)
+        {
+            int end = std::min((int)legs.size(), (t + 1) * TRANSFER_TASK);
+            for (int i = t * TRANSFER_TASK; i < end; i++)
+                find_transfer_by(a_index, b_index, legs[i], d, comp, best[w]);
+        };
+        int tasks = (legs.size() + TRANSFER_TASK - 1) / TRANSFER_TASK;
+        if (tasks > 1)
+            Thread_Pool::instance().run(tasks, task);
+        else if (tasks)
+            task(0, 0);
+        Transfer_Best res;
+        for (int i = 0; i < MAX_THREADS; i++)
+            if (best[i].found && better(best[i], res, comp))
+                res = best[i];
+        if (res.found) ret = res.info;
+        return res.found;
+    }
+
+    // try train[0] from the reach table for a train by b
+    void find_transfer_by(const vector<Index_Info>& a_index, const vector<Index_Info>& b_index,
+                          const Transfer_Leg& leg, Date d, bool (*comp)(const Transfer_Info&, const Transfer_Info&),
+                          Transfer_Best& best)
+    {
+        const Train_Data* b_train = &leg.train;
+        char b_id = b_index[leg.index].num;
+        Transfer_Best tmp;
+        tmp.info.train_id[1] = b_index[leg.index].train_id;
+        tmp.info.t_id[1] = b_id;
+        // iterate over stations earlier than b
+        for (int j = 0; j < b_id; j++)
+        {
+            int station = leg.stations.id[j];
+            if (reach_stamp[station] != stamp) continue;
+            // iterate over possible train[0]
+            for (int k = reach_head[station]; k != -1; k = reach[k].next)
             {
-                auto found = from_a.find(b_train->stations[j]);
-                if (found == from_a.end()) continue;
-                // iterate over possible train[0]
-                for (auto k = found->second.begin(); k != found->second.end(); k++)
+                const Reach& r = reach[k];
+                const Mystring<21>& a_id = a_index[r.index].train_id;
+                // check duplicate
+                if (a_id == b_index[leg.index].train_id)
+                    continue;
+                // find earliest required departure date of b_train
+                Time a_t = r.leave, t_t = r.arrive;
+                Date t_d = d;
+                t_d += t_t.day() - a_t.day();
+                t_t = t_t.clock();
+                Time b_leave_t = b_train->leave_time[j];
+                int offset = b_leave_t.day();
+                b_leave_t = b_leave_t.clock();
+                Date require_d = t_d - offset + (int)(b_leave_t < t_t);
+                if (b_train->end_date < require_d)
+                    continue;
+                // fill in tmp
+                tmp.info.train_id[0] = a_id;
+                tmp.info.date = std::max(b_train->start_date, require_d);
+                tmp.info.time = (r.arrive - r.leave) +
+                    time_between(t_d, t_t, tmp.info.date + offset, b_leave_t) + 
+                    (b_train->arrive_time[b_id-1] - b_train->leave_time[j]);
+                tmp.info.cost = r.price + (b_train->price[b_id] - b_train->price[j]);
+                tmp.order = (long long)leg.index << 40 | (long long)j << 32 | k;
+                // try update best
+                if (!best.found || better(tmp, best, comp))
                 {
-                    auto a_id = a_index[(*k).first].train_id;
-                    // check duplicate
-                    if (a_id == b_index[i].train_id)
-                        continue;
-                    char f_id = a_index[(*k).first].num;
-                    char t_id = (*k).second;
-                    auto a_train = train_db.readonly(a_id);
-                    // find earliest required departure date of b_train
-                    Time a_t = a_train->leave_time[f_id], t_t = a_train->arrive_time[t_id-1];
-                    Date t_d = d;
-                    t_d += t_t.h / 24 - a_t.h / 24;
-                    t_t.h %= 24;
-                    Time b_leave_t = b_train->leave_time[j];
-                    offset = b_leave_t.h / 24;
-                    b_leave_t.h %= 24;
-                    require_d = t_d - offset + (int)(b_leave_t < t_t);
-                    if (b_train->end_date < require_d)
-                        continue;
-                    // fill in tmp_info
-                    flag = true;
-                    tmp_info.train_id[0] = a_id;
-                    tmp_info.date = std::max(b_train->start_date, require_d);
-                    tmp_info.time = (a_train->arrive_time[t_id-1] - a_train->leave_time[f_id]) +
-                        time_between(t_d, t_t, tmp_info.date + offset, b_leave_t) + 
-                        (b_train->arrive_time[b_id-1] - b_train->leave_time[j]);
-                    tmp_info.cost = (a_train->price[t_id] - a_train->price[f_id]) + 
-                        (b_train->price[b_id] - b_train->price[j]);
-                    // try update ret
-                    if (comp(tmp_info, ret))
-                    {
-                        tmp_info.f_id[0] = f_id;
-                        tmp_info.f_id[1] = j;
-                        tmp_info.t_id[0] = t_id;
-                        ret = tmp_info;
-                    }
+                    tmp.info.f_id[0] = a_index[r.index].num;
+                    tmp.info.f_id[1] = j;
+                    tmp.info.t_id[0] = r.t_id;
+                    tmp.found = true;
+                    best = tmp;
                 }
             }
         }
-        return flag; 
+    }
+
+    static inline bool better(const Transfer_Best& x, const Transfer_Best& y,
+                              bool (*comp)(const Transfer_Info&, const Transfer_Info&))
+    {
+        if (!y.found) return true;
+        if (comp(x.info, y.info)) return true;
+        return !comp(y.info, x.info) && x.order < y.order;
     }
 
 };
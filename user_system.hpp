@@ -15,6 +15,8 @@ struct User_Data
     char password[31];
     char name[16];
     char mail[31];
+    long orders; // address of the newest order in order_db, -1 for none
+    int order_num;
 };
 
 class User_System
@@ -28,13 +30,15 @@ public:
         return userdb.empty();
     }
 
-    int add_first_user(const std::string& username, const User_Data& data)
+    int add_first_user(const std::string& username, User_Data& data)
     {
+        data.orders = -1;
+        data.order_num = 0;
         userdb.insert(username, data);
         return 0;
     }
 
-    int add_user(const std::string& cur_user, const std::string& new_user, const User_Data& data)
+    int add_user(const std::string& cur_user, const std::string& new_user, User_Data& data)
     {
         auto found = user_list.find(cur_user);
         if (found == user_list.end() || !found->second)
@@ -43,6 +47,8 @@ public:
         if (ptr->priv <= data.priv) return -1;
         ptr = userdb.readonly(new_user);
         if (ptr != nullptr) return -1;
+        data.orders = -1;
+        data.order_num = 0;
         userdb.insert(new_user, data);
         return 0;
     }
@@ -106,6 +112,22 @@ public:
         return true;
     }
 
+    // the newest order of u and the number of orders
+    void order_log(const std::string& u, long& head, int& count)
+    {
+        auto info = userdb.readonly(u);
+        head = info->orders;
+        count = info->order_num;
+    }
+
+    // u has made a new order at address
+    void add_order(const std::string& u, long address)
+    {
+        auto info = userdb.readwrite(u);
+        info->orders = address;
+        info->order_num++;
+    }
+
     void clean()
     {
         userdb.clean();
@@ -113,7 +135,7 @@ public:
     }
 
 private:
-    BPT<Mystring<21>, User_Data> userdb;
+    BPT<Mystring<21>, User_Data, Bloom_Filter> userdb;
     map<std::string, bool> user_list;
     
 };